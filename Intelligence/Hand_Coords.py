@@ -1,14 +1,79 @@
 import cv2
+import ctypes
 import mediapipe as mp
+import mmap
 import numpy as np
 import socket
+import struct
+import sys
 import threading
+import time
+
+# Gesture frames, must match include/Custom/gesture_input.h: 32 bytes, little endian.
+# magic "GX", version, type, sequence number, capture time in microseconds since the epoch, 4 float32 payload
+GESTURE_PROTOCOL_VERSION = 1
+GESTURE_PAN = 1
+GESTURE_ORBIT = 2
+GESTURE_FRAME = struct.Struct('<2sBBIQ4f')
+gesture_sequence = 0
+
+# Shared memory ring, must match include/Custom/gesture_shared_memory.h. The viewer creates it, start it with --gestures=shm.
+GESTURE_SHM_NAME = "Local\\GripXelGestures"
+GESTURE_DOORBELL_NAME = "Local\\GripXelGesturesDoorbell"
+GESTURE_SHM_VERSION = 1
+GESTURE_SHM_HEAD = 64
+GESTURE_SHM_TAIL = 128
+GESTURE_SHM_FRAMES = 192
+GESTURE_SHM_CAPACITY = 256
+GESTURE_SHM_BYTES = GESTURE_SHM_FRAMES + GESTURE_SHM_CAPACITY * GESTURE_FRAME.size
+EVENT_MODIFY_STATE = 0x0002
+
+class SharedMemoryGestures:
+    def __init__(self):
+        self.ring = mmap.mmap(-1, GESTURE_SHM_BYTES, tagname=GESTURE_SHM_NAME)
+        magic, version, frame_bytes, capacity = struct.unpack_from('<4sIII', self.ring, 0)
+        if magic != b'GXSM' or version != GESTURE_SHM_VERSION or frame_bytes != GESTURE_FRAME.size or capacity != GESTURE_SHM_CAPACITY:
+            raise RuntimeError("no gesture ring to write to, start the viewer with --gestures=shm first")
+        self.kernel32 = ctypes.WinDLL('kernel32', use_last_error=True)
+        self.kernel32.OpenEventW.restype = ctypes.c_void_p
+        self.kernel32.SetEvent.argtypes = [ctypes.c_void_p]
+        self.doorbell = self.kernel32.OpenEventW(EVENT_MODIFY_STATE, False, GESTURE_DOORBELL_NAME)
+        if not self.doorbell:
+            raise RuntimeError("could not open the gesture doorbell, error %d" % ctypes.get_last_error())
+        # aligned 64 bit words, ctypes reads and stores them in one go so the viewer never sees half an update
+        self.shared_head = ctypes.c_uint64.from_buffer(self.ring, GESTURE_SHM_HEAD)
+        self.shared_tail = ctypes.c_uint64.from_buffer(self.ring, GESTURE_SHM_TAIL)
+        self.head = self.shared_head.value
+        self.dropped = 0
+
+    def send(self, frame):
+        tail = self.shared_tail.value
+        if self.head - tail >= GESTURE_SHM_CAPACITY:
+            # the viewer is a full ring behind, drop rather than overwrite what it hasn't read
+            self.dropped += 1
+            return
+        slot = GESTURE_SHM_FRAMES + (self.head % GESTURE_SHM_CAPACITY) * GESTURE_FRAME.size
+        self.ring[slot:slot + GESTURE_FRAME.size] = frame
+        # publish the frame only once it's written, then wake the viewer's reader
+        self.head += 1
+        self.shared_head.value = self.head
+        self.kernel32.SetEvent(self.doorbell)
 
 #Nets
-client_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-host = '127.0.0.1'
-port = 12345
-client_socket.connect((host, port))
+if "--shm" in sys.argv:
+    shared_gestures = SharedMemoryGestures()
+    send_frame = shared_gestures.send
+else:
+    client_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    host = '127.0.0.1'
+    port = 12345
+    client_socket.connect((host, port))
+    send_frame = client_socket.sendall
+
+def send_gesture(kind, captured_us, x=0.0, y=0.0, z=0.0, w=0.0):
+    global gesture_sequence
+    gesture_sequence = (gesture_sequence + 1) & 0xFFFFFFFF
+    send_frame(GESTURE_FRAME.pack(b'GX', GESTURE_PROTOCOL_VERSION, kind, gesture_sequence, captured_us, x, y, z, w))
 
 # Initialize MediaPipe Hands
 mp_hands = mp.solutions.hands
@@ -48,6 +113,7 @@ def normalize(value, min_value=-1, max_value=1):
 while cap.isOpened():
     # Read a frame from the webcam
     success, image = cap.read()
+    captured_us = time.time_ns() // 1000
     if not success:
         print("Ignoring empty camera frame.")
         continue
@@ -100,7 +166,7 @@ while cap.isOpened():
             #Nets
             message = (f"C {normalized_x:.1f} {normalized_y:.1f}")
             print(message);
-            client_socket.sendall(message.encode('utf-8'))
+            send_gesture(GESTURE_PAN, captured_us, float(normalized_x), float(normalized_y))
             
     # Show the image
     cv2.imshow('Hand Tracking', image)
@@ -0,0 +1,101 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cstddef>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BOUNDS_USE_SSE 1
+#endif
+
+struct BoundingSphere
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// axis aligned bounding box. Starts out empty (min > max) so extending it with anything just works.
+struct Bounds
+{
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+    void extend(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(const Bounds& other)
+    {
+        if (!other.valid())
+            return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const { return valid() ? (min + max) * 0.5f : glm::vec3(0.0f); }
+    glm::vec3 size() const { return valid() ? max - min : glm::vec3(0.0f); }
+
+    // sphere around the box: cheap, a little loose, good enough for culling and LOD selection
+    BoundingSphere sphere() const
+    {
+        BoundingSphere result;
+        result.center = center();
+        result.radius = glm::length(size()) * 0.5f;
+        return result;
+    }
+};
+
+// bounds of count positions that are stride bytes apart (e.g. &vertices[0].Position, sizeof(Vertex)).
+// SSE reduction with four lanes per load; the fourth lane reads whatever follows the position and is
+// thrown away at the end, so the position must never be the last member of the element.
+inline Bounds computeBounds(const glm::vec3* firstPosition, size_t count, size_t stride)
+{
+    Bounds bounds;
+    if (count == 0)
+        return bounds;
+
+    const char* base = reinterpret_cast<const char*>(firstPosition);
+#ifdef BOUNDS_USE_SSE
+    __m128 low = _mm_set1_ps(FLT_MAX);
+    __m128 high = _mm_set1_ps(-FLT_MAX);
+    size_t i = 0;
+    // two independent accumulators per side hide the min/max latency
+    __m128 low2 = low, high2 = high;
+    for (; i + 1 < count; i += 2)
+    {
+        __m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(base + i * stride));
+        __m128 b = _mm_loadu_ps(reinterpret_cast<const float*>(base + (i + 1) * stride));
+        low = _mm_min_ps(low, a);
+        high = _mm_max_ps(high, a);
+        low2 = _mm_min_ps(low2, b);
+        high2 = _mm_max_ps(high2, b);
+    }
+    if (i < count)
+    {
+        __m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(base + i * stride));
+        low = _mm_min_ps(low, a);
+        high = _mm_max_ps(high, a);
+    }
+    low = _mm_min_ps(low, low2);
+    high = _mm_max_ps(high, high2);
+
+    float lowLanes[4], highLanes[4];
+    _mm_storeu_ps(lowLanes, low);
+    _mm_storeu_ps(highLanes, high);
+    bounds.min = glm::vec3(lowLanes[0], lowLanes[1], lowLanes[2]);
+    bounds.max = glm::vec3(highLanes[0], highLanes[1], highLanes[2]);
+#else
+    for (size_t i = 0; i < count; i++)
+        bounds.extend(*reinterpret_cast<const glm::vec3*>(base + i * stride));
+#endif
+    return bounds;
+}
+
+#endif // !BOUNDS_H
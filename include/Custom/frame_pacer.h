@@ -0,0 +1,98 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+
+// Render on demand.
+// An idle scene looks the same every frame, so drawing it again only burns a core and the GPU. Everything that
+// changes the picture tells the pacer: input callbacks and scene changes call invalidate(), anything that moves on
+// its own (LOD fades, a running import) calls animate() for as long as it runs. When a frame is due the loop polls
+// and draws as before; otherwise wait() sleeps in glfwWaitEventsTimeout until the next window event or wake().
+// Threads that feed the scene (the gesture socket) call wake() the moment they have something, so input is never
+// held back by the timeout.
+
+// frames drawn after an input event, ImGui needs a couple to settle hover and popup state
+const int FRAME_PACER_SETTLE_FRAMES = 3;
+// longest sleep while idle, a safety net for changes nothing woke us for
+const double FRAME_PACER_IDLE_TIMEOUT = 1.0;
+// how often the idle statistics are printed
+const double FRAME_PACER_REPORT_SECONDS = 60.0;
+
+class FramePacer
+{
+public:
+    // false draws every iteration like a plain render loop
+    bool onDemand = true;
+
+    // the picture changed, draw the next few frames
+    void invalidate() { settleFrames = FRAME_PACER_SETTLE_FRAMES; }
+
+    // something is animating, draw the next frame
+    void animate()
+    {
+        if (settleFrames < 1)
+            settleFrames = 1;
+    }
+
+    bool due() const { return !onDemand || settleFrames > 0; }
+
+    // any thread. Ends a wait() right away.
+    static void wake() { glfwPostEmptyEvent(); }
+
+    // main thread, once per iteration. Polls the events when a frame is due and sleeps until the next one otherwise.
+    // Returns the seconds spent asleep, they don't count as frame time.
+    double wait()
+    {
+        if (due())
+        {
+            glfwPollEvents();
+            return 0.0;
+        }
+        const double started = glfwGetTime();
+        glfwWaitEventsTimeout(FRAME_PACER_IDLE_TIMEOUT);
+        const double slept = glfwGetTime() - started;
+        asleep += slept;
+        return slept;
+    }
+
+    // main thread, after a frame was swapped
+    void presented()
+    {
+        if (settleFrames > 0)
+            settleFrames--;
+        frames++;
+    }
+
+    // main thread. Prints the frames drawn and the share of time asleep every FRAME_PACER_REPORT_SECONDS,
+    // cpuSeconds is the CPU time the process used so far.
+    void report(double cpuSeconds)
+    {
+        const double now = glfwGetTime();
+        if (reportStarted < 0.0)
+        {
+            reportStarted = now;
+            reportCpu = cpuSeconds;
+            return;
+        }
+        const double elapsed = now - reportStarted;
+        if (elapsed < FRAME_PACER_REPORT_SECONDS)
+            return;
+        std::cout << "IDLE: " << frames << " frames in " << elapsed << " s, asleep " << 100.0 * asleep / elapsed
+                  << "% of the time, " << 100.0 * (cpuSeconds - reportCpu) / elapsed << "% of a core" << std::endl;
+        reportStarted = now;
+        reportCpu = cpuSeconds;
+        frames = 0;
+        asleep = 0.0;
+    }
+
+private:
+    int settleFrames = FRAME_PACER_SETTLE_FRAMES;   // the first frames are always drawn
+    unsigned int frames = 0;
+    double asleep = 0.0;
+    double reportStarted = -1.0;
+    double reportCpu = 0.0;
+};
+
+#endif // !FRAME_PACER_H
@@ -0,0 +1,123 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <Custom/gl_handle.h>
+#include <Custom/index_format.h>
+#include <Custom/vertex_format.h>
+
+#include <cstdint>
+#include <vector>
+
+// Shared vertex/index storage for all meshes of a Model.
+// Meshes with the same vertex layout and index width live in one pool: one VBO, one EBO and one VAO.
+// Each mesh is a slice of its pool (base vertex + first index), so the whole pool can be drawn with
+// a single glMultiDrawElementsBaseVertex instead of a bind and a draw per mesh.
+//
+// Filling it is two phase so mapped cache data goes to GL without an extra copy:
+//   reserve() every mesh, allocate() the buffers once, then write() each mesh into its slice.
+// The arena owns the buffers and deletes them with itself, so it has to die on the GL thread.
+class GeometryArena
+{
+public:
+    struct Slice
+    {
+        unsigned int pool = 0;
+        GLint baseVertex = 0;
+        size_t firstIndex = 0;
+    };
+
+    GeometryArena() = default;
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // claims room for a mesh. Can run on any thread, nothing touches GL until allocate().
+    Slice reserve(const VertexFormat& format, GLenum indexType, size_t vertexCount, size_t indexCount)
+    {
+        unsigned int index = 0;
+        // pools that already have their buffers are full, anything reserved later gets a new pool
+        while (index < pools.size() && (pools[index].VAO || pools[index].format.flags != format.flags || pools[index].indexType != indexType))
+            index++;
+        if (index == pools.size())
+        {
+            pools.push_back(Pool());
+            pools.back().format = format;
+            pools.back().indexType = indexType;
+        }
+
+        Pool& pool = pools[index];
+        Slice slice;
+        slice.pool = index;
+        slice.baseVertex = static_cast<GLint>(pool.vertexCount);
+        slice.firstIndex = pool.indexCount;
+        pool.vertexCount += vertexCount;
+        pool.indexCount += indexCount;
+        return slice;
+    }
+
+    // GL thread only. Creates the buffers for everything reserved so far and sets up the VAOs.
+    void allocate()
+    {
+        for (Pool& pool : pools)
+        {
+            if (pool.VAO)
+                continue;
+            pool.VAO = GLVertexArray::create();
+            pool.VBO = GLBuffer::create();
+            pool.EBO = GLBuffer::create();
+
+            glBindVertexArray(pool.VAO.get());
+            glBindBuffer(GL_ARRAY_BUFFER, pool.VBO.get());
+            glBufferData(GL_ARRAY_BUFFER, pool.vertexCount * pool.format.stride, NULL, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO.get());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, pool.indexCount * indexSize(pool.indexType), NULL, GL_STATIC_DRAW);
+            setupVertexAttributes(pool.format);
+            glBindVertexArray(0);
+        }
+    }
+
+    // GL thread only. Copies a mesh into the slice reserve() gave it.
+    void write(const Slice& slice, const void* vertices, size_t vertexCount, const void* indices, size_t indexCount)
+    {
+        const Pool& pool = pools[slice.pool];
+        glBindBuffer(GL_ARRAY_BUFFER, pool.VBO.get());
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(slice.baseVertex) * pool.format.stride, vertexCount * pool.format.stride, vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // no VAO bound, so this doesn't change any VAO's index buffer
+        glBindVertexArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO.get());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, slice.firstIndex * indexSize(pool.indexType), indexCount * indexSize(pool.indexType), indices);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    unsigned int VAO(unsigned int pool) const { return pools[pool].VAO.get(); }
+    const VertexFormat& format(unsigned int pool) const { return pools[pool].format; }
+    GLenum indexType(unsigned int pool) const { return pools[pool].indexType; }
+    size_t poolCount() const { return pools.size(); }
+
+private:
+    struct Pool
+    {
+        VertexFormat format;
+        GLenum indexType = GL_UNSIGNED_INT;
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        GLVertexArray VAO;
+        GLBuffer VBO, EBO;
+    };
+
+    std::vector<Pool> pools;
+};
+
+// meshes of one pool that share their textures, submitted with one glMultiDrawElementsBaseVertex
+struct DrawBatch
+{
+    unsigned int pool = 0;
+    size_t material = 0;                // index of a mesh whose textures every mesh in the batch uses
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;   // byte offsets into the pool's index buffer
+    std::vector<GLint> baseVertices;
+};
+
+#endif // !GEOMETRY_ARENA_H
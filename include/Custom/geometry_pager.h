@@ -0,0 +1,344 @@
+#ifndef GEOMETRY_PAGER_H
+#define GEOMETRY_PAGER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Custom/bounds.h>
+#include <Custom/geometry_arena.h>
+#include <Custom/mesh_cache.h>
+#include <Custom/thread_pool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Out-of-core geometry for models that don't fit the memory budgets.
+// The mesh cache file is the backing store and its chunks (runs of meshes that are close in space) are
+// what gets paged. Every frame update() ranks the chunks in view by their size on screen, the same measure
+// that picks the LODs, and keeps the best ones on the GPU as far as gpuBudget allows. A chunk is read from
+// the file on the thread pool, stays in CPU memory within cpuBudget so it can come back to the GPU without
+// touching the disk, and is uploaded into a GeometryArena of its own. Both levels evict least recently used first.
+
+const uint64_t PAGING_GPU_BUDGET_BYTES = 1024ull * 1024 * 1024;
+const uint64_t PAGING_CPU_BUDGET_BYTES = 512ull * 1024 * 1024;
+// upload at most this much geometry per frame so a burst of finished reads can't stall a frame
+const uint64_t PAGING_UPLOAD_BYTES_PER_FRAME = 32ull * 1024 * 1024;
+const unsigned int PAGING_MAX_READS = 4;
+// chunks covering fewer pixels than this aren't worth memory
+const float PAGING_MIN_PIXELS = 2.0f;
+
+class GeometryPager
+{
+public:
+    explicit GeometryPager(const CachedModel& cached)
+        : cached(cached), file(std::make_shared<ChunkFile>(cached.file.path())), finished(std::make_shared<FinishedQueue>())
+    {
+        chunks.resize(cached.header->chunkCount);
+        slices.resize(cached.header->meshCount);
+    }
+
+    GeometryPager(const GeometryPager&) = delete;
+    GeometryPager& operator=(const GeometryPager&) = delete;
+
+    // GL thread, once per frame. modelViewProjection and modelView go from model space to clip and view space,
+    // scale is the largest scale of the model matrix and pixelsPerUnit as in Model::selectLods.
+    // Returns true if chunks arrived on or left the GPU, the meshes pointing into them have to be rebuilt.
+    bool update(const glm::mat4& modelViewProjection, const glm::mat4& modelView, float scale, float pixelsPerUnit, uint64_t cpuBudget, uint64_t gpuBudget)
+    {
+        frame++;
+        bool changed = false;
+        backlog = false;
+        collectReads();
+
+        // rank what's in view
+        glm::vec4 planes[6];
+        frustumPlanes(modelViewProjection, planes);
+        ranked.clear();
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            const Bounds box = chunkBounds(c);
+            if (!box.valid() || outside(planes, box))
+                continue;
+            const BoundingSphere sphere = box.sphere();
+            const float distance = -(modelView * glm::vec4(sphere.center, 1.0f)).z;
+            const float pixels = distance > sphere.radius * scale ? sphere.radius * pixelsPerUnit / distance : FLT_MAX;
+            if (pixels >= PAGING_MIN_PIXELS)
+                ranked.push_back(std::make_pair(pixels, c));
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first > b.first; });
+
+        // the biggest chunks on screen that fit the GPU budget together are this frame's working set
+        uint64_t planned = 0;
+        uint64_t uploaded = 0;
+        for (const std::pair<float, size_t>& rank : ranked)
+        {
+            const size_t c = rank.second;
+            const uint64_t size = cached.chunks[c].dataSize;
+            if (planned + size > gpuBudget)
+                continue;
+            planned += size;
+            ChunkState& chunk = chunks[c];
+            chunk.lastUsed = frame;
+            if (chunk.arena)
+                continue;
+            if (chunk.data)
+            {
+                if (uploaded >= PAGING_UPLOAD_BYTES_PER_FRAME)
+                {
+                    backlog = true;
+                    continue;
+                }
+                changed |= makeRoomOnGpu(size, gpuBudget);
+                upload(c);
+                uploaded += size;
+                changed = true;
+            }
+            else if (!chunk.reading && !chunk.failed && readsInFlight < PAGING_MAX_READS && makeRoomOnCpu(size, cpuBudget))
+            {
+                requestRead(c);
+            }
+        }
+
+        // the budgets may have shrunk since the last frame
+        changed |= makeRoomOnGpu(0, gpuBudget);
+        makeRoomOnCpu(0, cpuBudget);
+        return changed;
+    }
+
+    // reads are on the way or chunks wait for upload, the next update() changes what's resident even if the view doesn't
+    bool busy() const { return readsInFlight > 0 || backlog; }
+
+    size_t chunkCount() const { return chunks.size(); }
+    const MeshCacheChunk& chunk(size_t c) const { return cached.chunks[c]; }
+    Bounds chunkBounds(size_t c) const
+    {
+        Bounds box;
+        box.min = glm::vec3(cached.chunks[c].aabbMin[0], cached.chunks[c].aabbMin[1], cached.chunks[c].aabbMin[2]);
+        box.max = glm::vec3(cached.chunks[c].aabbMax[0], cached.chunks[c].aabbMax[1], cached.chunks[c].aabbMax[2]);
+        return box;
+    }
+
+    // the chunk is on the GPU, its meshes live in arena(c) at slice(mesh)
+    bool onGpu(size_t c) const { return chunks[c].arena != nullptr; }
+    const GeometryArena& arena(size_t c) const { return *chunks[c].arena; }
+    const GeometryArena::Slice& slice(uint32_t mesh) const { return slices[mesh]; }
+
+    uint64_t cpuBytes() const { return cpuUsed; }
+    uint64_t gpuBytes() const { return gpuUsed; }
+
+private:
+    // a second handle on the cache file, shared with the reads in flight so they can outlive the pager
+    class ChunkFile
+    {
+    public:
+        explicit ChunkFile(const std::filesystem::path& path)
+        {
+            file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        }
+        ~ChunkFile()
+        {
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+        }
+        ChunkFile(const ChunkFile&) = delete;
+        ChunkFile& operator=(const ChunkFile&) = delete;
+
+        bool read(uint64_t offset, char* out, uint64_t size) const
+        {
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            while (size > 0)
+            {
+                OVERLAPPED at = {};
+                at.Offset = static_cast<DWORD>(offset);
+                at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+                const DWORD wanted = static_cast<DWORD>((std::min)(size, uint64_t(1) << 30));
+                DWORD got = 0;
+                if (!ReadFile(file, out, wanted, &got, &at) || got == 0)
+                    return false;
+                offset += got;
+                out += got;
+                size -= got;
+            }
+            return true;
+        }
+
+    private:
+        HANDLE file = INVALID_HANDLE_VALUE;
+    };
+
+    struct FinishedRead
+    {
+        size_t chunk;
+        std::shared_ptr<std::vector<char>> data;    // null if the read failed
+    };
+
+    struct FinishedQueue
+    {
+        std::mutex lock;
+        std::deque<FinishedRead> reads;
+    };
+
+    struct ChunkState
+    {
+        std::unique_ptr<GeometryArena> arena;
+        std::shared_ptr<std::vector<char>> data;
+        uint64_t lastUsed = 0;
+        bool reading = false;
+        bool failed = false;
+    };
+
+    const CachedModel& cached;
+    std::shared_ptr<ChunkFile> file;
+    std::shared_ptr<FinishedQueue> finished;
+    std::vector<ChunkState> chunks;
+    std::vector<GeometryArena::Slice> slices;
+    std::vector<std::pair<float, size_t>> ranked;
+    uint64_t frame = 0;
+    uint64_t cpuUsed = 0, gpuUsed = 0;
+    unsigned int readsInFlight = 0;
+    bool backlog = false;   // the last update() left read chunks over for the next frames
+
+    void requestRead(size_t c)
+    {
+        const MeshCacheChunk& chunk = cached.chunks[c];
+        chunks[c].reading = true;
+        readsInFlight++;
+        cpuUsed += chunk.dataSize;
+        // the task only holds on to the file and the queue, so it stays safe even if the pager is gone before it finishes
+        std::shared_ptr<ChunkFile> source = file;
+        std::shared_ptr<FinishedQueue> queue = finished;
+        const uint64_t offset = chunk.dataOffset, size = chunk.dataSize;
+        ThreadPool::instance().submit([source, queue, c, offset, size]() {
+            std::shared_ptr<std::vector<char>> data = std::make_shared<std::vector<char>>(static_cast<size_t>(size));
+            if (!source->read(offset, data->data(), size))
+                data.reset();
+
+            std::lock_guard<std::mutex> lock(queue->lock);
+            queue->reads.push_back(FinishedRead{ c, std::move(data) });
+        });
+    }
+
+    void collectReads()
+    {
+        std::deque<FinishedRead> reads;
+        {
+            std::lock_guard<std::mutex> lock(finished->lock);
+            reads.swap(finished->reads);
+        }
+        for (FinishedRead& read : reads)
+        {
+            ChunkState& chunk = chunks[read.chunk];
+            chunk.reading = false;
+            readsInFlight--;
+            if (!read.data)
+            {
+                std::cout << "ERROR::GEOMETRY_PAGER:: could not read chunk " << read.chunk << " of " << cached.file.path().u8string() << std::endl;
+                chunk.failed = true;
+                cpuUsed -= cached.chunks[read.chunk].dataSize;
+                continue;
+            }
+            chunk.data = std::move(read.data);
+        }
+    }
+
+    // GL thread only. One arena per chunk, so evicting it is just deleting the arena.
+    void upload(size_t c)
+    {
+        const MeshCacheChunk& chunk = cached.chunks[c];
+        ChunkState& state = chunks[c];
+        state.arena.reset(new GeometryArena());
+        for (uint32_t m = chunk.firstMesh; m < chunk.firstMesh + chunk.meshCount; m++)
+        {
+            const MeshCacheEntry& entry = cached.entries[m];
+            slices[m] = state.arena->reserve(makeVertexFormat(entry.vertexFlags), entry.indexType, entry.vertexCount, entry.indexCount);
+        }
+        state.arena->allocate();
+        const char* base = state.data->data();
+        for (uint32_t m = chunk.firstMesh; m < chunk.firstMesh + chunk.meshCount; m++)
+        {
+            const MeshCacheEntry& entry = cached.entries[m];
+            state.arena->write(slices[m], base + (entry.vertexOffset - chunk.dataOffset), entry.vertexCount,
+                               base + (entry.indexOffset - chunk.dataOffset), entry.indexCount);
+        }
+        gpuUsed += chunk.dataSize;
+    }
+
+    // evicts least recently used chunks that aren't part of this frame until size more bytes fit the GPU budget
+    bool makeRoomOnGpu(uint64_t size, uint64_t budget)
+    {
+        bool evicted = false;
+        while (gpuUsed + size > budget)
+        {
+            size_t victim = chunks.size();
+            for (size_t c = 0; c < chunks.size(); c++)
+            {
+                if (chunks[c].arena && chunks[c].lastUsed != frame && (victim == chunks.size() || chunks[c].lastUsed < chunks[victim].lastUsed))
+                    victim = c;
+            }
+            if (victim == chunks.size())
+                break;
+            chunks[victim].arena.reset();
+            gpuUsed -= cached.chunks[victim].dataSize;
+            evicted = true;
+        }
+        return evicted;
+    }
+
+    // same for CPU memory. Chunks already on the GPU can always give their copy up, the rest only if unused
+    // this frame. Returns whether size more bytes fit now.
+    bool makeRoomOnCpu(uint64_t size, uint64_t budget)
+    {
+        while (cpuUsed + size > budget)
+        {
+            size_t victim = chunks.size();
+            for (size_t c = 0; c < chunks.size(); c++)
+            {
+                const ChunkState& chunk = chunks[c];
+                if (chunk.data && (chunk.arena || chunk.lastUsed != frame) && (victim == chunks.size() || chunk.lastUsed < chunks[victim].lastUsed))
+                    victim = c;
+            }
+            if (victim == chunks.size())
+                return false;
+            chunks[victim].data.reset();
+            cpuUsed -= cached.chunks[victim].dataSize;
+        }
+        return true;
+    }
+
+    // planes of the view frustum in model space, pointing inwards (Gribb & Hartmann)
+    static void frustumPlanes(const glm::mat4& m, glm::vec4 planes[6])
+    {
+        const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+    }
+
+    static bool outside(const glm::vec4 planes[6], const Bounds& box)
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            // the corner furthest along the plane normal
+            const glm::vec3 corner(planes[p].x > 0.0f ? box.max.x : box.min.x, planes[p].y > 0.0f ? box.max.y : box.min.y, planes[p].z > 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f)
+                return true;
+        }
+        return false;
+    }
+};
+
+#endif // !GEOMETRY_PAGER_H
@@ -0,0 +1,386 @@
+#ifndef GESTURE_INPUT_H
+#define GESTURE_INPUT_H
+
+#include <winsock2.h>
+
+#include <Custom/gesture_shared_memory.h>
+#include <Custom/spsc_ring.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Gesture commands from the hand tracker (Intelligence/Hand_Coords.py) and anything else speaking its protocol.
+// A thread of its own waits for frames, either in WSAPoll() on the listening socket and every connected client or
+// on the doorbell of a GestureSharedMemory ring, takes everything that arrived, decodes it and queues the commands
+// for the render thread through an SpscRing, then wakes the render loop.
+// Clients may connect, drop and come back at any time, up to GESTURE_MAX_CLIENTS at once. Each keeps its own
+// receive buffer and sequence numbers, and their commands meet in the one queue. The render thread takes everything queued so far right
+// before it builds the view matrix, so a gesture shows in the next frame whatever the frame rate is, and a slow
+// frame no longer leaves messages piling up in the transport.
+//
+// Wire format, version 1. Every frame is GESTURE_FRAME_BYTES long, all fields little endian:
+//   0  char[2]  magic "GX"
+//   2  uint8    version
+//   3  uint8    type, a GestureKind
+//   4  uint32   sequence number, counts up by one per frame the sender sends
+//   8  uint64   capture time, microseconds since the Unix epoch on the sender's clock
+//  16  float32  payload[4], x y z w. A pan carries the normalized finger position in x and y.
+// Frames are decoded in place, in the receive buffer or the shared mapping. On TCP, bytes that don't start a frame
+// are skipped up to the next magic, so a sender that got out of step costs the frames in between and nothing more.
+// The sender runs on this machine, which makes the capture time comparable to our clock: commands older than
+// GESTURE_STALE_MS are dropped.
+
+enum GestureKind
+{
+    GESTURE_PAN = 1,
+    GESTURE_ORBIT = 2
+};
+
+struct GestureCommand
+{
+    GestureKind kind;
+    unsigned int client;        // connection it came from, 0 for the shared memory ring
+    uint32_t sequence;
+    uint64_t captureMicros;
+    float payload[4];
+};
+
+// the commands of one frame folded together
+struct GestureFrame
+{
+    unsigned int commands = 0;          // taken from the queue, stale ones included
+    unsigned int stale = 0;
+    bool pan = false;
+    float panX = 0.0f, panY = 0.0f;     // most recently captured finger position of any client, the pan speed follows it
+    unsigned int panClient = 0;
+    bool orbit = false;
+};
+
+const uint8_t GESTURE_PROTOCOL_VERSION = 1;
+const size_t GESTURE_FRAME_BYTES = 32;
+static_assert(GESTURE_FRAME_BYTES == GESTURE_SHM_FRAME_BYTES, "the shared memory ring carries the same frames");
+const size_t GESTURE_QUEUE_CAPACITY = 1024;
+const size_t GESTURE_READ_BYTES = 4096;
+const size_t GESTURE_MAX_CLIENTS = 8;
+// longest WSAPoll() wait, how soon the server notices stop()
+const int GESTURE_POLL_TIMEOUT_MS = 100;
+// pause after a failed WSAPoll() before the next try
+const int GESTURE_POLL_RETRY_MS = 250;
+// a gesture this old only drags the view after the hand
+const double GESTURE_STALE_MS = 100.0;
+
+// microseconds since the Unix epoch, the clock the sender stamps its frames with
+inline uint64_t gestureClockMicros()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+class GestureInput
+{
+public:
+    GestureInput() = default;
+    ~GestureInput() { stop(); }
+
+    GestureInput(const GestureInput&) = delete;
+    GestureInput& operator=(const GestureInput&) = delete;
+
+    // starts serving a listening, non-blocking socket: accepts clients and reads them all. wake is called on the
+    // reader thread whenever commands were queued.
+    void start(SOCKET listener, void (*wake)())
+    {
+        this->listener = listener;
+        this->wake = wake;
+        reader = std::thread(&GestureInput::serveLoop, this);
+    }
+
+    // starts reading an open shared memory ring instead, it has to outlive the reader
+    void start(GestureSharedMemory& ring, void (*wake)())
+    {
+        shared = &ring;
+        this->wake = wake;
+        reader = std::thread(&GestureInput::readSharedLoop, this);
+    }
+
+    // ends the reader and closes the clients' connections, the caller still closes the listener or the ring
+    void stop()
+    {
+        if (!reader.joinable())
+            return;
+        stopping = true;
+        if (shared != nullptr)
+            shared->ring();
+        reader.join();
+    }
+
+    // render thread only. Takes everything queued so far: stale commands are dropped, of the pans the one captured
+    // last wins whichever client sent it, and the orbits count once.
+    GestureFrame drain()
+    {
+        GestureFrame frame;
+        GestureCommand command;
+        uint64_t panCaptured = 0;
+        const uint64_t now = gestureClockMicros();
+        while (queue.pop(command))
+        {
+            frame.commands++;
+            const double age = now > command.captureMicros ? (now - command.captureMicros) / 1000.0 : 0.0;
+            if (age > GESTURE_STALE_MS)
+            {
+                frame.stale++;
+                continue;
+            }
+            applied++;
+            ageSum += age;
+            if (command.kind == GESTURE_PAN)
+            {
+                if (frame.pan && command.captureMicros < panCaptured)
+                    continue;
+                frame.pan = true;
+                frame.panX = command.payload[0];
+                frame.panY = command.payload[1];
+                frame.panClient = command.client;
+                panCaptured = command.captureMicros;
+            }
+            else
+            {
+                frame.orbit = true;
+            }
+        }
+        staleCount += frame.stale;
+        return frame;
+    }
+
+    // render thread only: commands applied, their mean age when drain() took them and the ones dropped as stale
+    size_t appliedCommands() const { return applied; }
+    double meanAgeMs() const { return applied > 0 ? ageSum / applied : 0.0; }
+    size_t stale() const { return staleCount; }
+
+    // clients connected right now
+    size_t clientCount() const { return connected.load(std::memory_order_relaxed); }
+
+    // frames a sender numbered but we never got, and commands lost because the render thread was a full queue behind
+    size_t skipped() const { return skippedCount.load(std::memory_order_relaxed); }
+    size_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+    // bytes thrown away while looking for the next frame
+    size_t malformed() const { return malformedBytes.load(std::memory_order_relaxed); }
+
+private:
+    // where the frames of one source stand
+    struct Stream
+    {
+        unsigned int client = 0;
+        bool haveSequence = false;
+        uint32_t lastSequence = 0;
+    };
+
+    struct Client
+    {
+        SOCKET socket = INVALID_SOCKET;
+        Stream stream;
+        unsigned char buffer[GESTURE_READ_BYTES];
+        size_t buffered = 0;    // the start of a frame the last read cut off
+    };
+
+    SOCKET listener = INVALID_SOCKET;
+    GestureSharedMemory* shared = nullptr;
+    void (*wake)() = nullptr;
+    std::thread reader;
+    std::atomic<bool> stopping{ false };
+    SpscRing<GestureCommand, GESTURE_QUEUE_CAPACITY> queue;
+    std::atomic<size_t> droppedCount{ 0 };
+    std::atomic<size_t> skippedCount{ 0 };
+    std::atomic<size_t> malformedBytes{ 0 };
+    std::atomic<size_t> connected{ 0 };
+    size_t applied = 0;
+    size_t staleCount = 0;
+    double ageSum = 0.0;
+    // reader thread only
+    std::vector<std::unique_ptr<Client>> clients;
+    unsigned int nextClient = 1;
+
+    static uint32_t readU32(const unsigned char* bytes)
+    {
+        return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 | static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+    }
+
+    static uint64_t readU64(const unsigned char* bytes)
+    {
+        return static_cast<uint64_t>(readU32(bytes)) | static_cast<uint64_t>(readU32(bytes + 4)) << 32;
+    }
+
+    static float readF32(const unsigned char* bytes)
+    {
+        const uint32_t bits = readU32(bytes);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static bool startsFrame(const unsigned char* bytes)
+    {
+        return bytes[0] == 'G' && bytes[1] == 'X' && bytes[2] == GESTURE_PROTOCOL_VERSION
+            && (bytes[3] == GESTURE_PAN || bytes[3] == GESTURE_ORBIT);
+    }
+
+    // decodes a frame that startsFrame() and queues it, true if it was queued
+    bool deliver(const unsigned char* bytes, Stream& stream)
+    {
+        GestureCommand command;
+        command.kind = static_cast<GestureKind>(bytes[3]);
+        command.client = stream.client;
+        command.sequence = readU32(bytes + 4);
+        command.captureMicros = readU64(bytes + 8);
+        for (int i = 0; i < 4; i++)
+            command.payload[i] = readF32(bytes + 16 + 4 * i);
+
+        if (stream.haveSequence && command.sequence - stream.lastSequence > 1 && command.sequence - stream.lastSequence < 0x80000000u)
+            skippedCount.fetch_add(command.sequence - stream.lastSequence - 1, std::memory_order_relaxed);
+        stream.haveSequence = true;
+        stream.lastSequence = command.sequence;
+
+        if (queue.push(command))
+            return true;
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void serveLoop()
+    {
+        std::vector<WSAPOLLFD> polled;
+        int failing = 0;    // error of the WSAPoll() failures in a row, reported once
+        while (!stopping)
+        {
+            // the listener first, then the clients in order
+            polled.clear();
+            polled.push_back(WSAPOLLFD{ listener, POLLRDNORM, 0 });
+            for (const auto& client : clients)
+                polled.push_back(WSAPOLLFD{ client->socket, POLLRDNORM, 0 });
+            const int ready = WSAPoll(polled.data(), static_cast<ULONG>(polled.size()), GESTURE_POLL_TIMEOUT_MS);
+            if (ready == SOCKET_ERROR)
+            {
+                const int error = WSAGetLastError();
+                if (error != failing)
+                    std::cerr << "Networking error: " << error << std::endl;
+                failing = error;
+                // only a listener that's gone for good ends the server, trackers can still connect after anything else
+                if (error == WSAENOTSOCK)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(GESTURE_POLL_RETRY_MS));
+                continue;
+            }
+            failing = 0;
+            if (ready == 0)
+                continue;
+
+            bool queued = false;
+            // backwards, so dropping a client doesn't shift the ones still to do
+            for (size_t i = clients.size(); i-- > 0;)
+            {
+                if (polled[i + 1].revents == 0)
+                    continue;
+                if (!readClient(*clients[i], queued))
+                {
+                    std::cout << "Gesture client " << clients[i]->stream.client << " disconnected." << std::endl;
+                    closesocket(clients[i]->socket);
+                    clients.erase(clients.begin() + i);
+                }
+            }
+            if (polled[0].revents & POLLRDNORM)
+                acceptClients();
+            connected.store(clients.size(), std::memory_order_relaxed);
+
+            if (queued && wake != nullptr)
+                wake();
+        }
+        for (const auto& client : clients)
+            closesocket(client->socket);
+        clients.clear();
+        connected.store(0, std::memory_order_relaxed);
+    }
+
+    // takes every connection waiting on the listener
+    void acceptClients()
+    {
+        for (;;)
+        {
+            const SOCKET accepted = accept(listener, nullptr, nullptr);
+            if (accepted == INVALID_SOCKET)
+            {
+                if (WSAGetLastError() != WSAEWOULDBLOCK)
+                    std::cerr << "Accept Failed! " << WSAGetLastError() << std::endl;
+                return;
+            }
+            if (clients.size() >= GESTURE_MAX_CLIENTS)
+            {
+                std::cout << "Gesture client refused, " << GESTURE_MAX_CLIENTS << " are connected already." << std::endl;
+                closesocket(accepted);
+                continue;
+            }
+            u_long nonBlocking = 1;
+            ioctlsocket(accepted, FIONBIO, &nonBlocking);
+            clients.emplace_back(new Client());
+            clients.back()->socket = accepted;
+            clients.back()->stream.client = nextClient++;
+            std::cout << "Gesture client " << clients.back()->stream.client << " connected." << std::endl;
+        }
+    }
+
+    // reads everything the client has sent so far, false once it's gone
+    bool readClient(Client& client, bool& queued)
+    {
+        for (;;)
+        {
+            const int received = recv(client.socket, reinterpret_cast<char*>(client.buffer + client.buffered), static_cast<int>(sizeof(client.buffer) - client.buffered), 0);
+            if (received == 0)
+                return false;
+            if (received == SOCKET_ERROR)
+                return WSAGetLastError() == WSAEWOULDBLOCK;
+            client.buffered += static_cast<size_t>(received);
+
+            size_t offset = 0;
+            while (client.buffered - offset >= GESTURE_FRAME_BYTES)
+            {
+                const unsigned char* bytes = client.buffer + offset;
+                if (!startsFrame(bytes))
+                {
+                    malformedBytes.fetch_add(1, std::memory_order_relaxed);
+                    offset++;
+                    continue;
+                }
+                queued |= deliver(bytes, client.stream);
+                offset += GESTURE_FRAME_BYTES;
+            }
+            // keep the partial frame for the next read
+            client.buffered -= offset;
+            std::memmove(client.buffer, client.buffer + offset, client.buffered);
+        }
+    }
+
+    void readSharedLoop()
+    {
+        Stream stream;
+        for (;;)
+        {
+            shared->wait();
+            if (stopping)
+                return;
+            bool queued = false;
+            shared->consume([this, &queued, &stream](const unsigned char* bytes) {
+                if (startsFrame(bytes))
+                    queued |= deliver(bytes, stream);
+                else
+                    malformedBytes.fetch_add(GESTURE_FRAME_BYTES, std::memory_order_relaxed);
+            });
+            if (queued && wake != nullptr)
+                wake();
+        }
+    }
+};
+
+#endif // !GESTURE_INPUT_H
@@ -0,0 +1,134 @@
+#ifndef GESTURE_SHARED_MEMORY_H
+#define GESTURE_SHARED_MEMORY_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// Shared memory transport for gesture frames, for a tracker on the same machine.
+// The viewer creates a named file mapping holding a ring of frames plus a named auto-reset event, the doorbell.
+// The tracker writes a frame into the slot at head, publishes it by bumping head and rings the doorbell; the
+// reader thread wakes, decodes the frames straight out of the mapping and moves tail up to head. A delivery is
+// then a memory write and one event signal, no socket and no copy through the kernel.
+//
+// Layout, all integers little endian:
+//   0    char[4]  magic "GXSM"
+//   4    uint32   version
+//   8    uint32   bytes per frame, GESTURE_SHM_FRAME_BYTES
+//   12   uint32   capacity in frames, a power of two
+//   64   uint64   head, frames written. Only the tracker stores to it.
+//   128  uint64   tail, frames consumed. Only the viewer stores to it.
+//   192  frames, frame n lives in slot n % capacity
+// The tracker drops a frame rather than overwrite one the viewer hasn't read, head - tail never exceeds capacity.
+// Intelligence/Hand_Coords.py --shm is the writer.
+
+const char GESTURE_SHM_NAME[] = "Local\\GripXelGestures";
+const char GESTURE_DOORBELL_NAME[] = "Local\\GripXelGesturesDoorbell";
+const uint32_t GESTURE_SHM_VERSION = 1;
+const uint32_t GESTURE_SHM_FRAME_BYTES = 32;
+const uint32_t GESTURE_SHM_CAPACITY = 256;
+
+struct GestureShmHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t frameBytes;
+    uint32_t capacity;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the tracker process stores head as a plain 64 bit word");
+const size_t GESTURE_SHM_FRAMES_OFFSET = 192;
+static_assert(sizeof(GestureShmHeader) <= GESTURE_SHM_FRAMES_OFFSET, "the frames start after the header");
+const size_t GESTURE_SHM_BYTES = GESTURE_SHM_FRAMES_OFFSET + GESTURE_SHM_CAPACITY * GESTURE_SHM_FRAME_BYTES;
+
+class GestureSharedMemory
+{
+public:
+    GestureSharedMemory() = default;
+    ~GestureSharedMemory() { close(); }
+
+    GestureSharedMemory(const GestureSharedMemory&) = delete;
+    GestureSharedMemory& operator=(const GestureSharedMemory&) = delete;
+
+    // creates the mapping and the doorbell and resets the ring. False if either can't be created.
+    bool open()
+    {
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(GESTURE_SHM_BYTES), GESTURE_SHM_NAME);
+        if (mapping == NULL)
+        {
+            std::cout << "ERROR::GESTURE_SHM:: could not create " << GESTURE_SHM_NAME << ", error " << GetLastError() << std::endl;
+            return false;
+        }
+        view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, GESTURE_SHM_BYTES);
+        doorbellEvent = CreateEventA(NULL, FALSE, FALSE, GESTURE_DOORBELL_NAME);
+        if (view == NULL || doorbellEvent == NULL)
+        {
+            std::cout << "ERROR::GESTURE_SHM:: could not map the ring or create its doorbell, error " << GetLastError() << std::endl;
+            close();
+            return false;
+        }
+
+        // a tracker that started first may have written already, what it wrote is older than this viewer
+        GestureShmHeader* header = this->header();
+        header->version = GESTURE_SHM_VERSION;
+        header->frameBytes = GESTURE_SHM_FRAME_BYTES;
+        header->capacity = GESTURE_SHM_CAPACITY;
+        header->tail.store(header->head.load(std::memory_order_acquire), std::memory_order_release);
+        std::memcpy(header->magic, "GXSM", 4);
+        return true;
+    }
+
+    void close()
+    {
+        if (view != NULL)
+            UnmapViewOfFile(view);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (doorbellEvent != NULL)
+            CloseHandle(doorbellEvent);
+        view = NULL;
+        mapping = NULL;
+        doorbellEvent = NULL;
+    }
+
+    bool isOpen() const { return view != NULL; }
+
+    // reader thread. Blocks until the tracker rang the doorbell (or ring() was called).
+    void wait() const { WaitForSingleObject(doorbellEvent, INFINITE); }
+
+    // any thread, ends a wait()
+    void ring() const { SetEvent(doorbellEvent); }
+
+    // reader thread. Hands every frame written since the last call to read(const unsigned char* frame), in place
+    // in the mapping, then gives their slots back to the tracker. Returns the number of frames.
+    template <typename Reader>
+    size_t consume(Reader read)
+    {
+        GestureShmHeader* header = this->header();
+        const uint64_t head = header->head.load(std::memory_order_acquire);
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        // a tracker that lost count can't make us read more than the ring holds
+        if (head - tail > GESTURE_SHM_CAPACITY)
+            tail = head - GESTURE_SHM_CAPACITY;
+        const size_t count = static_cast<size_t>(head - tail);
+        const unsigned char* frames = static_cast<const unsigned char*>(view) + GESTURE_SHM_FRAMES_OFFSET;
+        for (; tail != head; tail++)
+            read(frames + (tail & (GESTURE_SHM_CAPACITY - 1)) * GESTURE_SHM_FRAME_BYTES);
+        header->tail.store(tail, std::memory_order_release);
+        return count;
+    }
+
+private:
+    HANDLE mapping = NULL;
+    HANDLE doorbellEvent = NULL;
+    void* view = NULL;
+
+    GestureShmHeader* header() const { return static_cast<GestureShmHeader*>(view); }
+};
+
+#endif // !GESTURE_SHARED_MEMORY_H
@@ -0,0 +1,104 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+
+// Move-only owners of GL object names.
+// A handle deletes its object when it goes out of scope, so whoever holds it decides when the object dies,
+// and a copy can never end up deleting a name that is still in use elsewhere. Handles must die on the GL
+// thread while the context is current, like the objects themselves.
+//
+// Every kind keeps a count of its live objects. glLiveObjects() is 0 once everything was released,
+// which the shutdown path checks (and a test can assert on).
+
+struct GLBufferTraits
+{
+    static GLuint create() { GLuint name = 0; glGenBuffers(1, &name); return name; }
+    static void destroy(GLuint name) { glDeleteBuffers(1, &name); }
+    static std::atomic<int>& live() { static std::atomic<int> count{ 0 }; return count; }
+};
+
+struct GLVertexArrayTraits
+{
+    static GLuint create() { GLuint name = 0; glGenVertexArrays(1, &name); return name; }
+    static void destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+    static std::atomic<int>& live() { static std::atomic<int> count{ 0 }; return count; }
+};
+
+struct GLTextureTraits
+{
+    static GLuint create() { GLuint name = 0; glGenTextures(1, &name); return name; }
+    static void destroy(GLuint name) { glDeleteTextures(1, &name); }
+    static std::atomic<int>& live() { static std::atomic<int> count{ 0 }; return count; }
+};
+
+struct GLProgramTraits
+{
+    static GLuint create() { return glCreateProgram(); }
+    static void destroy(GLuint name) { glDeleteProgram(name); }
+    static std::atomic<int>& live() { static std::atomic<int> count{ 0 }; return count; }
+};
+
+template <typename Traits>
+class GLHandle
+{
+public:
+    GLHandle() = default;
+    ~GLHandle() { reset(); }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : name(other.name) { other.name = 0; }
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            name = other.name;
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    // GL thread only. A new object owned by the returned handle.
+    static GLHandle create()
+    {
+        GLHandle handle;
+        handle.name = Traits::create();
+        if (handle.name != 0)
+            Traits::live()++;
+        return handle;
+    }
+
+    // GL thread only. Deletes the object now instead of when the handle goes away.
+    void reset()
+    {
+        if (name == 0)
+            return;
+        Traits::destroy(name);
+        Traits::live()--;
+        name = 0;
+    }
+
+    GLuint get() const { return name; }
+    explicit operator bool() const { return name != 0; }
+
+private:
+    GLuint name = 0;
+};
+
+typedef GLHandle<GLBufferTraits>      GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits>     GLTexture;
+typedef GLHandle<GLProgramTraits>     GLProgram;
+
+// objects of every kind still alive
+inline int glLiveObjects()
+{
+    return GLBufferTraits::live() + GLVertexArrayTraits::live() + GLTextureTraits::live() + GLProgramTraits::live();
+}
+
+#endif // !GL_HANDLE_H
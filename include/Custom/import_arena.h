@@ -0,0 +1,163 @@
+#ifndef IMPORT_ARENA_H
+#define IMPORT_ARENA_H
+
+#include <Custom/thread_pool.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Scratch memory for one import.
+// Converting a mesh builds a pile of short lived arrays (the unpacked vertices and indices, the optimizer's and
+// simplifier's working sets, the preview) that are all dead once the mesh is packed. Instead of going to the heap
+// for each of them, every thread converting meshes gets a monotonic arena: an allocation just bumps a pointer in
+// a block the thread keeps for the whole import, and a Scope rewinds it in one go when its mesh is done.
+// Only meshes that outgrow the block reach the heap. The blocks go away with the ImportArena at the end of the import.
+//
+// A slot belongs to one pool worker (or to the thread running the import), so the arenas need no locking.
+
+// per thread block, enough for the scratch of a mesh with a few ten thousand vertices
+const size_t IMPORT_ARENA_BLOCK_BYTES = 16 * 1024 * 1024;
+
+// counts the allocations made through it and passes them on
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+
+    size_t allocations() const { return count.load(std::memory_order_relaxed); }
+    size_t bytes() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::pmr::memory_resource* upstream;
+    std::atomic<size_t> count{ 0 };
+    std::atomic<size_t> total{ 0 };
+
+    void* do_allocate(size_t size, size_t alignment) override
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(size, std::memory_order_relaxed);
+        return upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* pointer, size_t size, size_t alignment) override
+    {
+        upstream->deallocate(pointer, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+class ImportArena
+{
+private:
+    struct Slot
+    {
+        void* block = nullptr;
+        std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+        std::unique_ptr<CountingResource> front;     // what the Scope hands out, counts the allocations served
+        bool busy = false;
+    };
+
+public:
+    explicit ImportArena(size_t blockBytes = IMPORT_ARENA_BLOCK_BYTES)
+        : blockBytes(blockBytes), heap(std::pmr::new_delete_resource())
+    {
+        // one slot per pool worker, plus one for the thread that runs the import and helps out in parallelFor
+        const size_t slotCount = ThreadPool::instance().size() + 1;
+        for (size_t i = 0; i < slotCount; i++)
+            slots.emplace_back(new Slot());
+    }
+
+    ~ImportArena()
+    {
+        for (auto& slot : slots)
+        {
+            slot->front.reset();
+            slot->arena.reset();
+            if (slot->block != nullptr)
+                heap.deallocate(slot->block, blockBytes, alignof(std::max_align_t));
+        }
+    }
+
+    ImportArena(const ImportArena&) = delete;
+    ImportArena& operator=(const ImportArena&) = delete;
+
+    // scratch for the work the calling thread does while the Scope lives, e.g. converting one mesh.
+    // Everything allocated through resource() is gone once the Scope ends.
+    class Scope
+    {
+    public:
+        explicit Scope(ImportArena& owner) : owner(owner)
+        {
+            const int worker = ThreadPool::workerIndex();
+            slot = owner.slots[worker >= 0 ? static_cast<size_t>(worker) : owner.slots.size() - 1].get();
+            if (slot->busy)
+            {
+                // a task nested in another one on this thread, rewinding the slot would pull memory from under the outer
+                // one. It gets an arena of its own that starts out empty.
+                slot = &nested;
+                slot->arena.reset(new std::pmr::monotonic_buffer_resource(&owner.heap));
+            }
+            else if (!slot->arena)
+            {
+                slot->block = owner.heap.allocate(owner.blockBytes, alignof(std::max_align_t));
+                slot->arena.reset(new std::pmr::monotonic_buffer_resource(slot->block, owner.blockBytes, &owner.heap));
+            }
+            if (!slot->front)
+                slot->front.reset(new CountingResource(slot->arena.get()));
+            slot->busy = true;
+        }
+
+        ~Scope()
+        {
+            if (slot == &nested)
+            {
+                owner.nestedAllocations.fetch_add(nested.front->allocations(), std::memory_order_relaxed);
+                return;
+            }
+            // back to the start of the block, whatever spilled over to the heap is freed
+            slot->arena->release();
+            slot->busy = false;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        std::pmr::memory_resource* resource() const { return slot->front.get(); }
+
+    private:
+        ImportArena& owner;
+        Slot* slot;
+        Slot nested;
+    };
+
+    // allocations served by the arenas so far
+    size_t allocations() const
+    {
+        size_t count = nestedAllocations.load(std::memory_order_relaxed);
+        for (const auto& slot : slots)
+        {
+            if (slot->front)
+                count += slot->front->allocations();
+        }
+        return count;
+    }
+
+    // how many of them reached the heap (the blocks included), and how many bytes that was
+    size_t heapAllocations() const { return heap.allocations(); }
+    size_t heapBytes() const { return heap.bytes(); }
+
+private:
+    size_t blockBytes;
+    CountingResource heap;
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::atomic<size_t> nestedAllocations{ 0 };
+};
+
+#endif // !IMPORT_ARENA_H
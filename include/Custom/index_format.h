@@ -0,0 +1,135 @@
+#ifndef INDEX_FORMAT_H
+#define INDEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <Custom/vertex_format.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+
+// Index width is picked per mesh: 16 bit whenever every index fits, 32 bit otherwise.
+// Meshes just over the 16 bit limit can be cut into ranges that each address at most 65536 vertices
+// and are drawn with their own base vertex, so they get the smaller indices as well.
+
+const size_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+// meshes with up to this many vertices are split into 16 bit ranges, bigger ones keep 32 bit indices. 0 turns splitting off.
+const size_t INDEX_SPLIT_MAX_VERTICES = 4 * SHORT_INDEX_VERTEX_LIMIT;
+
+// part of a mesh drawn with its own base vertex. Indices inside a range are relative to baseVertex.
+struct IndexRange
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t  baseVertex;
+};
+
+// one level of detail: a run of the mesh's index buffer (and of its ranges if it was split). Level 0 is the
+// full mesh. error is how far the level may deviate from the full mesh, in object space units.
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstRange;
+    uint32_t rangeCount;
+    float    error;
+};
+
+inline size_t indexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// rebuilds vertices/indices so that every range references at most SHORT_INDEX_VERTEX_LIMIT vertices.
+// Triangles keep their order; vertices shared between two ranges are duplicated. Does nothing (and returns
+// false) for meshes that already fit, are too big to be worth it, or when splitting is turned off.
+// Index positions don't move, and a new range is started at every LOD so each level maps to whole ranges.
+inline bool splitIndexRanges(std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices, std::vector<IndexRange>& ranges, std::vector<MeshLod>& lods)
+{
+    if (vertices.size() <= SHORT_INDEX_VERTEX_LIMIT || vertices.size() > INDEX_SPLIT_MAX_VERTICES || indices.size() % 3 != 0)
+        return false;
+
+    std::pmr::memory_resource* scratch = vertices.get_allocator().resource();
+    std::pmr::vector<Vertex> splitVertices(scratch);
+    std::pmr::vector<unsigned int> splitIndices(scratch);
+    splitVertices.reserve(vertices.size() + vertices.size() / 8);
+    splitIndices.reserve(indices.size());
+    ranges.clear();
+
+    // local index of every source vertex in the current range, valid while its stamp matches the range number
+    std::pmr::vector<unsigned int> local(vertices.size(), scratch);
+    std::pmr::vector<uint32_t> stamp(vertices.size(), 0, scratch);
+    uint32_t range = 1;
+    size_t rangeStart = 0;
+    size_t rangeFirstIndex = 0;
+    size_t nextLod = 1;
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const bool lodStarts = nextLod < lods.size() && i == lods[nextLod].firstIndex;
+        if (lodStarts)
+            nextLod++;
+        unsigned int added = 0;
+        for (int corner = 0; corner < 3; corner++)
+            added += stamp[indices[i + corner]] != range ? 1 : 0;
+        if ((lodStarts && i > rangeFirstIndex) || splitVertices.size() - rangeStart + added > SHORT_INDEX_VERTEX_LIMIT)
+        {
+            ranges.push_back(IndexRange{ static_cast<uint32_t>(rangeFirstIndex), static_cast<uint32_t>(splitIndices.size() - rangeFirstIndex), static_cast<int32_t>(rangeStart) });
+            range++;
+            rangeStart = splitVertices.size();
+            rangeFirstIndex = splitIndices.size();
+        }
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const unsigned int source = indices[i + corner];
+            if (stamp[source] != range)
+            {
+                stamp[source] = range;
+                local[source] = static_cast<unsigned int>(splitVertices.size() - rangeStart);
+                splitVertices.push_back(vertices[source]);
+            }
+            splitIndices.push_back(local[source]);
+        }
+    }
+    ranges.push_back(IndexRange{ static_cast<uint32_t>(rangeFirstIndex), static_cast<uint32_t>(splitIndices.size() - rangeFirstIndex), static_cast<int32_t>(rangeStart) });
+
+    vertices.swap(splitVertices);
+    indices.swap(splitIndices);
+
+    for (MeshLod& lod : lods)
+    {
+        lod.firstRange = 0;
+        while (lod.firstRange < ranges.size() && ranges[lod.firstRange].firstIndex < lod.firstIndex)
+            lod.firstRange++;
+        lod.rangeCount = 0;
+        while (lod.firstRange + lod.rangeCount < ranges.size() && ranges[lod.firstRange + lod.rangeCount].firstIndex < lod.firstIndex + lod.indexCount)
+            lod.rangeCount++;
+    }
+    return true;
+}
+
+// copies indices into out at the narrowest width that holds them and returns the matching GL type.
+// With ranges the indices are relative to each range's base vertex, so only the largest index matters.
+inline GLenum packIndices(const unsigned int* indices, size_t count, std::vector<unsigned char>& out)
+{
+    unsigned int largest = 0;
+    for (size_t i = 0; i < count; i++)
+        largest = indices[i] > largest ? indices[i] : largest;
+
+    if (largest < SHORT_INDEX_VERTEX_LIMIT)
+    {
+        out.resize(count * sizeof(uint16_t));
+        uint16_t* dst = reinterpret_cast<uint16_t*>(out.data());
+        for (size_t i = 0; i < count; i++)
+            dst[i] = static_cast<uint16_t>(indices[i]);
+        return GL_UNSIGNED_SHORT;
+    }
+    out.resize(count * sizeof(uint32_t));
+    if (count > 0)
+        std::memcpy(out.data(), indices, count * sizeof(uint32_t));
+    return GL_UNSIGNED_INT;
+}
+
+#endif // !INDEX_FORMAT_H
@@ -0,0 +1,121 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Texture {
+    unsigned int id;
+    std::string type;
+    std::string path;
+};
+
+// Texture units of the model shaders.
+// We assume a convention for sampler names in the shaders: texture_diffuseN, texture_specularN, texture_normalN
+// and texture_heightN with N counting from 1. Every such sampler is tied to a fixed texture unit right after link
+// (Shader::resolveUniforms), so sampler uniforms never change while drawing. A Material then only binds its
+// textures to those units, from a list built once when the mesh is created.
+
+enum TextureKind
+{
+    TEXTURE_DIFFUSE,
+    TEXTURE_SPECULAR,
+    TEXTURE_NORMAL,
+    TEXTURE_HEIGHT,
+    TEXTURE_KIND_COUNT
+};
+
+// units per kind, 16 in total: the minimum GL 3.3 guarantees for a fragment shader
+const unsigned int MATERIAL_TEXTURES_PER_KIND = 4;
+
+inline const char* textureKindName(TextureKind kind)
+{
+    static const char* names[TEXTURE_KIND_COUNT] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+    return names[kind];
+}
+
+// kind of a Texture::type, -1 for anything the shaders have no samplers for
+inline int textureKindOf(const std::string& type)
+{
+    for (int kind = 0; kind < TEXTURE_KIND_COUNT; kind++)
+    {
+        if (type == textureKindName(static_cast<TextureKind>(kind)))
+            return kind;
+    }
+    return -1;
+}
+
+// the texture unit of sampler N of a kind, -1 if it doesn't fit into the units of its kind
+inline int materialUnit(int kind, unsigned int number)
+{
+    if (kind < 0 || number < 1 || number > MATERIAL_TEXTURES_PER_KIND)
+        return -1;
+    return static_cast<int>(kind * MATERIAL_TEXTURES_PER_KIND + number - 1);
+}
+
+// the texture unit a sampler uniform is tied to, from its name (texture_diffuse1 -> 0 and so on). -1 if it follows no convention.
+inline int samplerUnit(const std::string& uniform)
+{
+    for (int kind = 0; kind < TEXTURE_KIND_COUNT; kind++)
+    {
+        const char* prefix = textureKindName(static_cast<TextureKind>(kind));
+        const size_t length = std::strlen(prefix);
+        if (uniform.size() > length && uniform.compare(0, length, prefix) == 0)
+            return materialUnit(kind, static_cast<unsigned int>(std::atoi(uniform.c_str() + length)));
+    }
+    return -1;
+}
+
+struct MaterialBinding
+{
+    unsigned int unit;
+    unsigned int texture;
+
+    bool operator==(const MaterialBinding& other) const { return unit == other.unit && texture == other.texture; }
+    bool operator<(const MaterialBinding& other) const { return unit != other.unit ? unit < other.unit : texture < other.texture; }
+};
+
+class Material
+{
+public:
+    Material() = default;
+
+    // resolves the units of a mesh's textures. The textures must have their GL names already.
+    explicit Material(const std::vector<Texture>& textures)
+    {
+        unsigned int numbers[TEXTURE_KIND_COUNT] = {};
+        for (const Texture& texture : textures)
+        {
+            const int kind = textureKindOf(texture.type);
+            if (kind < 0)
+                continue;
+            const int unit = materialUnit(kind, ++numbers[kind]);
+            if (unit >= 0)
+                bindings.push_back(MaterialBinding{ static_cast<unsigned int>(unit), texture.id });
+        }
+    }
+
+    // binds every texture to its unit, leaves unit 0 active
+    void bind() const
+    {
+        for (const MaterialBinding& binding : bindings)
+        {
+            glActiveTexture(GL_TEXTURE0 + binding.unit);
+            glBindTexture(GL_TEXTURE_2D, binding.texture);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // materials that bind the same textures to the same units can share a draw
+    bool operator==(const Material& other) const { return bindings == other.bindings; }
+    bool operator<(const Material& other) const { return bindings < other.bindings; }
+
+private:
+    std::vector<MaterialBinding> bindings;
+};
+
+#endif // !MATERIAL_H
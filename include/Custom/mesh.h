@@ -5,35 +5,48 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <Custom/bounds.h>
+#include <Custom/geometry_arena.h>
+#include <Custom/gl_handle.h>
+#include <Custom/index_format.h>
+#include <Custom/material.h>
 #include <Custom/shader_s.h>
+#include <Custom/vertex_format.h>
 
+#include <algorithm>
+#include <cfloat>
 #include <string>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
+// smallest lodFade sent while a cross-fade runs, the fragment shader reads 0 as no dither at all
+const float LOD_FADE_MIN_COVERAGE = 1e-4f;
+
+// reasons to keep the CPU copy of a mesh's vertices and indices once it's on the GPU.
+// Without any, meshes only hold what drawing needs and the import drops the unpacked arrays right after packing.
+enum CpuGeometryUse
+{
+    CPU_GEOMETRY_PICKING = 1 << 0,
+    CPU_GEOMETRY_EXPORT  = 1 << 1,
+    CPU_GEOMETRY_LODS    = 1 << 2,
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// CPU side of a mesh as produced by the import workers. Nothing in here touches GL, so it can
+// be filled from any thread; the main thread resolves the textures and uploads it afterwards.
+struct MeshData
+{
+    vector<Vertex>       vertices;  // empty after packing unless a CpuGeometryUse keeps them
+    vector<unsigned int> indices;
+    size_t               vertexCount = 0;   // of the packed arrays, valid even when vertices/indices were dropped
+    size_t               indexCount = 0;
+    vector<Texture>      textures;  // id stays 0 until the upload step loads the texture
+    Bounds               bounds;
+    VertexFormat         format;
+    vector<unsigned char> packedVertices;  // vertices in the compact GPU layout described by format
+    GLenum               indexType = GL_UNSIGNED_INT;
+    vector<unsigned char> packedIndices;   // indices at the width given by indexType
+    vector<IndexRange>   ranges;           // empty unless the mesh was split to fit 16 bit indices
+    vector<MeshLod>      lods;             // level 0 is the full mesh, the simplified levels follow it in indices
 };
 
 class Mesh {
@@ -42,114 +55,162 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
-
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Material             material;  // the textures resolved to their units, all drawing needs of them
+    unsigned int VAO;           // the mesh's own vertex array, or its pool's in a GeometryArena
+    unsigned int indexCount;
+    GLenum indexType = GL_UNSIGNED_INT;
+    vector<IndexRange> ranges;  // drawn one by one with their base vertex, empty means one draw for the whole mesh
+    size_t firstIndex = 0;      // where the mesh starts in a shared GeometryArena pool, 0 for meshes with their own buffers
+    GLint baseVertex = 0;
+    unsigned int pool = 0;
+    vector<MeshLod> lods;       // never empty, level 0 is the full mesh
+    unsigned int lod = 0;       // level drawn this frame, picked by Model::selectLods
+    unsigned int fadingFrom = 0;
+    float fade = 1.0f;          // cross-fade progress from fadingFrom to lod, 1 when no fade is running
+    VertexFormat format;
+    Bounds         bounds;   // object space
+    BoundingSphere sphere;
+
+    // constructor, takes the arrays over. The CPU copies are released after the upload unless keepCpuGeometry.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool keepCpuGeometry = false)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        material = Material(this->textures);
+        if (!this->vertices.empty())
+            bounds = computeBounds(&this->vertices[0].Position, this->vertices.size(), sizeof(Vertex));
+        sphere = bounds.sphere();
+        format = makeVertexFormat(deduceVertexFlags(this->vertices.data(), this->vertices.size()));
+        vector<unsigned char> packed;
+        packVertices(this->vertices.data(), this->vertices.size(), format, packed);
+        vector<unsigned char> packedIndices;
+        indexType = packIndices(this->indices.data(), this->indices.size(), packedIndices);
+        lods.push_back(MeshLod{ 0, static_cast<uint32_t>(this->indices.size()), 0, 0, 0.0f });
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(packed.data(), this->vertices.size(), packedIndices.data(), this->indices.size());
+        if (!keepCpuGeometry)
+        {
+            vector<Vertex>().swap(this->vertices);
+            vector<unsigned int>().swap(this->indices);
+        }
     }
 
-    // render the mesh
-    void Draw(Shader& shader, Shader& blueShader)
+    // a mesh living in a slice of a shared GeometryArena. The arena owns the buffers, the data has to be written into the slice separately.
+    Mesh(const GeometryArena& arena, const GeometryArena::Slice& slice, size_t indexCount, vector<IndexRange> ranges, vector<MeshLod> lods,
+         vector<Texture> textures, const Bounds& bounds)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-        // Draw with the blue shader
-        blueShader.use();
-        glBindVertexArray(VAO);
-        glLineWidth(2.0f);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glCullFace(GL_FRONT);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glCullFace(GL_BACK);
+        this->textures = std::move(textures);
+        material = Material(this->textures);
+        this->format = arena.format(slice.pool);
+        this->indexType = arena.indexType(slice.pool);
+        this->ranges = std::move(ranges);
+        this->bounds = bounds;
+        sphere = bounds.sphere();
+        VAO = arena.VAO(slice.pool);
+        pool = slice.pool;
+        firstIndex = slice.firstIndex;
+        baseVertex = slice.baseVertex;
+        this->indexCount = static_cast<unsigned int>(indexCount);
+        this->lods = std::move(lods);
+        if (this->lods.empty())
+            this->lods.push_back(MeshLod{ 0, static_cast<uint32_t>(indexCount), 0, static_cast<uint32_t>(this->ranges.size()), 0.0f });
+    }
+
+    // a cross-fade between two levels is running, the mesh has to be drawn on its own
+    bool fading() const { return fade < 1.0f && fadingFrom != lod; }
 
-        // Draw with the first shader
+    // render the mesh, the shader draws the wireframe overlay in the same pass when it's switched on
+    void Draw(Shader& shader)
+    {
+        material.bind();
         shader.use();
-        //glBindVertexArray(VAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(VAO);
+        // tell the vertex shader whether this mesh carries a tangent frame or a plain octahedral normal
+        shader.setInt(UNIFORM_TANGENT_FRAME, format.has(VERTEX_TANGENT_FRAME) ? 1 : 0);
+        // during a cross-fade both levels are drawn with complementary dither patterns. A fade starts at 0, which
+        // the shader reads as no dither, so it's kept just above that or both levels would draw in full and z-fight.
+        const float coverage = fading() ? (std::max)(fade, LOD_FADE_MIN_COVERAGE) : 0.0f;
+        shader.setFloat(UNIFORM_LOD_FADE, coverage);
+        drawElements(lod);
+        if (fading())
+        {
+            shader.setFloat(UNIFORM_LOD_FADE, -coverage);
+            drawElements(fadingFrom);
+            shader.setFloat(UNIFORM_LOD_FADE, 0.0f);
+        }
         glActiveTexture(GL_TEXTURE0); // Reset active texture
 
         // Reset states
         glBindVertexArray(0);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Reset polygon mode
+    }
+
+    // adds this mesh's draws for the current level to a multi-draw batch of its pool
+    void appendTo(DrawBatch& batch) const
+    {
+        const size_t size = indexSize(indexType);
+        const MeshLod& level = lods[lod];
+        if (ranges.empty())
+        {
+            batch.counts.push_back(static_cast<GLsizei>(level.indexCount));
+            batch.offsets.push_back((const void*)((firstIndex + level.firstIndex) * size));
+            batch.baseVertices.push_back(baseVertex);
+            return;
+        }
+        for (uint32_t r = level.firstRange; r < level.firstRange + level.rangeCount; r++)
+        {
+            const IndexRange& range = ranges[r];
+            batch.counts.push_back(static_cast<GLsizei>(range.indexCount));
+            batch.offsets.push_back((const void*)((firstIndex + range.firstIndex) * size));
+            batch.baseVertices.push_back(baseVertex + range.baseVertex);
+        }
     }
 
 private:
-    // render data 
-    unsigned int VBO, EBO;
+    // render data, only set for meshes made by the first constructor. They're deleted with the mesh,
+    // and the handles make Mesh move-only so two meshes never share (and double delete) the same names.
+    GLVertexArray ownVAO;
+    GLBuffer VBO, EBO;
+
+    // issues the draw of one level for the bound VAO, one per range for split meshes
+    void drawElements(unsigned int level)
+    {
+        const size_t size = indexSize(indexType);
+        const MeshLod& run = lods[level];
+        if (ranges.empty())
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, run.indexCount, indexType, (void*)((firstIndex + run.firstIndex) * size), baseVertex);
+            return;
+        }
+        for (uint32_t r = run.firstRange; r < run.firstRange + run.rangeCount; r++)
+        {
+            const IndexRange& range = ranges[r];
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)((firstIndex + range.firstIndex) * size), baseVertex + range.baseVertex);
+        }
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void* vertexData, size_t vertexCount, const void* indexData, size_t indexCount)
     {
+        this->indexCount = static_cast<unsigned int>(indexCount);
+
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        ownVAO = GLVertexArray::create();
+        VBO = GLBuffer::create();
+        EBO = GLBuffer::create();
+        VAO = ownVAO.get();
 
         glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-        // ids
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-        // weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        // load data into vertex buffers, already packed into the compact layout of this mesh
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * format.stride, vertexData, GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(indexType), indexData, GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers, only the ones this mesh actually has
+        setupVertexAttributes(format);
         glBindVertexArray(0);
     }
 };
@@ -0,0 +1,603 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <Custom/mesh.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// GripXel mesh cache (.gxmc).
+// After the first import of a file the packed vertex and index arrays are written out next to
+// per-mesh bounds and texture references. Later imports of the same file map the cache read only
+// and hand the arrays straight to glBufferData, skipping Assimp entirely.
+//
+// layout, every section 16 byte aligned:
+//   MeshCacheHeader | MeshCacheEntry[meshCount] | MeshCacheTexture[textureCount] | IndexRange[rangeCount] | MeshLod[lodCount]
+//   | MeshCacheChunk[chunkCount] | string blob | vertex/index data
+// a cache file is only valid for the exact source path, size, mtime and post-process flags it was built from.
+// Meshes are stored in Morton order of their centers and grouped into chunks of neighbouring meshes, so a
+// model too big for memory can be paged in chunk by chunk (see GeometryPager).
+
+#define MESH_CACHE_VERSION 7
+
+const char MESH_CACHE_DIRECTORY[] = "GripXelCache";
+// least recently used files are deleted once the directory grows past this
+const uintmax_t MESH_CACHE_MAX_BYTES = 2ull * 1024 * 1024 * 1024;
+// a chunk is closed once its vertex and index data would grow past this
+const uint64_t MESH_CACHE_CHUNK_BYTES = 4 * 1024 * 1024;
+
+struct MeshCacheHeader
+{
+    char     magic[4];          // "GXMC"
+    uint32_t version;
+    uint32_t postProcessFlags;
+    uint32_t rangeCount;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t chunkCount;
+    uint32_t pathOffset;        // source path inside the string blob, to rule out hash collisions
+    uint32_t pathLength;
+    uint64_t fileSize;
+};
+
+struct MeshCacheEntry
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexFlags;       // VertexAttributeBits, the stride follows from them
+    uint32_t vertexStride;
+    uint32_t indexType;         // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    uint32_t firstRange;
+    uint32_t rangeCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    float    aabbMin[3];
+    float    aabbMax[3];
+};
+
+struct MeshCacheTexture
+{
+    uint32_t typeOffset, typeLength;
+    uint32_t pathOffset, pathLength;
+};
+
+// a run of entries whose vertex and index data form one contiguous block of the file
+struct MeshCacheChunk
+{
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint32_t firstMesh;
+    uint32_t meshCount;
+    float    aabbMin[3];
+    float    aabbMax[3];
+};
+
+// read only view of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::filesystem::path& path)
+    {
+        close();
+        file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+        {
+            close();
+            return false;
+        }
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == NULL)
+        {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(fileSize.QuadPart);
+        filePath = path;
+        return true;
+    }
+
+    void close()
+    {
+        if (view != NULL)
+            UnmapViewOfFile(view);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        view = NULL;
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+        length = 0;
+        filePath.clear();
+    }
+
+    const char* data() const { return static_cast<const char*>(view); }
+    size_t size() const { return length; }
+    const std::filesystem::path& path() const { return filePath; }
+
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    LPVOID view = NULL;
+    size_t length = 0;
+    std::filesystem::path filePath;
+};
+
+// one mapped cache file. The pointers stay valid as long as the CachedModel lives.
+struct CachedModel
+{
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+    const MeshCacheEntry* entries = nullptr;
+    const MeshCacheTexture* textures = nullptr;
+    const IndexRange* ranges = nullptr;
+    const MeshLod* lods = nullptr;
+    const MeshCacheChunk* chunks = nullptr;
+    const char* strings = nullptr;
+
+    const void* vertices(const MeshCacheEntry& entry) const { return file.data() + entry.vertexOffset; }
+    const void* indices(const MeshCacheEntry& entry) const { return file.data() + entry.indexOffset; }
+    string text(uint32_t offset, uint32_t length) const { return string(strings + offset, length); }
+};
+
+class MeshCache
+{
+public:
+    static MeshCache& instance()
+    {
+        static MeshCache cache(std::filesystem::u8path(MESH_CACHE_DIRECTORY), MESH_CACHE_MAX_BYTES);
+        return cache;
+    }
+
+    MeshCache(std::filesystem::path directory, uintmax_t maxBytes) : directory(std::move(directory)), maxBytes(maxBytes) {}
+
+    // maps the cache file for sourcePath if there is an up to date one. Returns false on any mismatch,
+    // in which case the caller goes through Assimp and calls store afterwards.
+    bool load(const string& sourcePath, unsigned int postProcessFlags, CachedModel& out)
+    {
+        SourceStamp stamp;
+        if (!stampOf(sourcePath, stamp))
+            return false;
+        std::filesystem::path cachePath = pathFor(sourcePath, stamp, postProcessFlags);
+        std::error_code error;
+        if (!std::filesystem::exists(cachePath, error))
+            return false;
+
+        // bump the file's time before mapping it, the LRU trimming goes by last write time
+        std::filesystem::last_write_time(cachePath, std::filesystem::file_time_type::clock::now(), error);
+
+        if (!out.file.open(cachePath))
+            return false;
+        if (!validate(out, sourcePath, stamp, postProcessFlags))
+        {
+            cout << "MESH CACHE: discarding stale or damaged " << cachePath.u8string() << '\n';
+            out.file.close();
+            std::filesystem::remove(cachePath, error);
+            return false;
+        }
+        return true;
+    }
+
+    // writes the converted meshes of sourcePath to the cache and trims the directory back under budget
+    void store(const string& sourcePath, unsigned int postProcessFlags, const vector<MeshData>& meshes)
+    {
+        SourceStamp stamp;
+        if (!stampOf(sourcePath, stamp))
+            return;
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        // entries follow the meshes in Morton order, so meshes close in space are close in the file
+        const vector<size_t> order = spatialOrder(meshes);
+
+        // string blob: source path first, then the texture types and paths
+        string strings = sourcePath;
+        vector<MeshCacheEntry> entries(meshes.size());
+        vector<MeshCacheTexture> textures;
+        vector<IndexRange> ranges;
+        vector<MeshLod> lods;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const MeshData& mesh = meshes[order[i]];
+            entries[i].firstLod = static_cast<uint32_t>(lods.size());
+            entries[i].lodCount = static_cast<uint32_t>(mesh.lods.size());
+            lods.insert(lods.end(), mesh.lods.begin(), mesh.lods.end());
+            entries[i].firstRange = static_cast<uint32_t>(ranges.size());
+            entries[i].rangeCount = static_cast<uint32_t>(mesh.ranges.size());
+            ranges.insert(ranges.end(), mesh.ranges.begin(), mesh.ranges.end());
+            entries[i].firstTexture = static_cast<uint32_t>(textures.size());
+            entries[i].textureCount = static_cast<uint32_t>(mesh.textures.size());
+            for (const Texture& texture : mesh.textures)
+            {
+                MeshCacheTexture record;
+                record.typeOffset = static_cast<uint32_t>(strings.size());
+                record.typeLength = static_cast<uint32_t>(texture.type.size());
+                strings += texture.type;
+                record.pathOffset = static_cast<uint32_t>(strings.size());
+                record.pathLength = static_cast<uint32_t>(texture.path.size());
+                strings += texture.path;
+                textures.push_back(record);
+            }
+        }
+
+        MeshCacheHeader header = {};
+        std::memcpy(header.magic, "GXMC", 4);
+        header.version = MESH_CACHE_VERSION;
+        header.postProcessFlags = postProcessFlags;
+        header.sourceSize = stamp.size;
+        header.sourceTime = stamp.time;
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        header.textureCount = static_cast<uint32_t>(textures.size());
+        header.rangeCount = static_cast<uint32_t>(ranges.size());
+        header.lodCount = static_cast<uint32_t>(lods.size());
+        header.pathOffset = 0;
+        header.pathLength = static_cast<uint32_t>(sourcePath.size());
+
+        const uint64_t entriesOffset = align(sizeof(MeshCacheHeader));
+        const uint64_t texturesOffset = align(entriesOffset + entries.size() * sizeof(MeshCacheEntry));
+        const uint64_t rangesOffset = align(texturesOffset + textures.size() * sizeof(MeshCacheTexture));
+        const uint64_t lodsOffset = align(rangesOffset + ranges.size() * sizeof(IndexRange));
+
+        // chunks: consecutive meshes until the data would pass MESH_CACHE_CHUNK_BYTES
+        vector<MeshCacheChunk> chunks;
+        {
+            uint64_t chunkBytes = 0;
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                const MeshData& mesh = meshes[order[i]];
+                const uint64_t bytes = align(mesh.packedVertices.size()) + align(mesh.packedIndices.size());
+                if (chunks.empty() || (chunkBytes > 0 && chunkBytes + bytes > MESH_CACHE_CHUNK_BYTES))
+                {
+                    chunks.push_back(MeshCacheChunk());
+                    chunks.back().firstMesh = static_cast<uint32_t>(i);
+                    chunkBytes = 0;
+                }
+                chunks.back().meshCount++;
+                chunkBytes += bytes;
+            }
+        }
+        header.chunkCount = static_cast<uint32_t>(chunks.size());
+        const uint64_t chunksOffset = align(lodsOffset + lods.size() * sizeof(MeshLod));
+        const uint64_t stringsOffset = align(chunksOffset + chunks.size() * sizeof(MeshCacheChunk));
+
+        uint64_t offset = align(stringsOffset + strings.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const MeshData& mesh = meshes[order[i]];
+            MeshCacheEntry& entry = entries[i];
+            entry.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+            entry.indexCount = static_cast<uint32_t>(mesh.indexCount);
+            entry.indexType = mesh.indexType;
+            entry.vertexFlags = mesh.format.flags;
+            entry.vertexStride = mesh.format.stride;
+            entry.vertexOffset = offset;
+            offset = align(offset + mesh.packedVertices.size());
+            entry.indexOffset = offset;
+            offset = align(offset + mesh.packedIndices.size());
+            for (int axis = 0; axis < 3; axis++)
+            {
+                entry.aabbMin[axis] = mesh.bounds.min[axis];
+                entry.aabbMax[axis] = mesh.bounds.max[axis];
+            }
+        }
+        header.fileSize = offset;
+
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            MeshCacheChunk& chunk = chunks[c];
+            const MeshCacheEntry& first = entries[chunk.firstMesh];
+            const MeshCacheEntry& last = entries[chunk.firstMesh + chunk.meshCount - 1];
+            chunk.dataOffset = first.vertexOffset;
+            chunk.dataSize = align(last.indexOffset + uint64_t(last.indexCount) * indexSize(last.indexType)) - chunk.dataOffset;
+            Bounds box;
+            for (uint32_t i = chunk.firstMesh; i < chunk.firstMesh + chunk.meshCount; i++)
+                box.extend(meshes[order[i]].bounds);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                chunk.aabbMin[axis] = box.min[axis];
+                chunk.aabbMax[axis] = box.max[axis];
+            }
+        }
+
+        // write to a temporary name first so a crash never leaves a half written cache behind
+        std::filesystem::path cachePath = pathFor(sourcePath, stamp, postProcessFlags);
+        std::filesystem::path tempPath = cachePath;
+        tempPath += ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return;
+            writeAt(out, 0, &header, sizeof(header));
+            writeAt(out, entriesOffset, entries.data(), entries.size() * sizeof(MeshCacheEntry));
+            writeAt(out, texturesOffset, textures.data(), textures.size() * sizeof(MeshCacheTexture));
+            writeAt(out, rangesOffset, ranges.data(), ranges.size() * sizeof(IndexRange));
+            writeAt(out, lodsOffset, lods.data(), lods.size() * sizeof(MeshLod));
+            writeAt(out, chunksOffset, chunks.data(), chunks.size() * sizeof(MeshCacheChunk));
+            writeAt(out, stringsOffset, strings.data(), strings.size());
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                const MeshData& mesh = meshes[order[i]];
+                writeAt(out, entries[i].vertexOffset, mesh.packedVertices.data(), mesh.packedVertices.size());
+                writeAt(out, entries[i].indexOffset, mesh.packedIndices.data(), mesh.packedIndices.size());
+            }
+            writeAt(out, header.fileSize, nullptr, 0);
+            if (!out)
+            {
+                out.close();
+                std::filesystem::remove(tempPath, error);
+                return;
+            }
+        }
+        std::filesystem::rename(tempPath, cachePath, error);
+        if (error)
+        {
+            std::filesystem::remove(tempPath, error);
+            return;
+        }
+        trim(cachePath);
+    }
+
+private:
+    struct SourceStamp
+    {
+        uint64_t size;
+        int64_t time;
+    };
+
+    std::filesystem::path directory;
+    uintmax_t maxBytes;
+
+    static uint64_t align(uint64_t offset) { return (offset + 15) & ~uint64_t(15); }
+
+    // spreads the low 10 bits of v so two zero bits follow each one
+    static uint32_t spreadBits(uint32_t v)
+    {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // mesh order along a Z curve through the mesh centers
+    static vector<size_t> spatialOrder(const vector<MeshData>& meshes)
+    {
+        Bounds all;
+        for (const MeshData& mesh : meshes)
+            all.extend(mesh.bounds);
+        const glm::vec3 extent = glm::max(all.size(), glm::vec3(1e-20f));
+
+        vector<std::pair<uint32_t, size_t>> keys(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            uint32_t code = 0;
+            if (meshes[i].bounds.valid())
+            {
+                const glm::vec3 cell = glm::clamp((meshes[i].bounds.center() - all.min) / extent, 0.0f, 1.0f) * 1023.0f;
+                code = spreadBits(static_cast<uint32_t>(cell.x)) | (spreadBits(static_cast<uint32_t>(cell.y)) << 1) | (spreadBits(static_cast<uint32_t>(cell.z)) << 2);
+            }
+            keys[i] = std::make_pair(code, i);
+        }
+        std::sort(keys.begin(), keys.end());
+        vector<size_t> order(meshes.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            order[i] = keys[i].second;
+        return order;
+    }
+
+    static void writeAt(std::ofstream& out, uint64_t offset, const void* data, size_t size)
+    {
+        // pad up to the section start; seeking past the end is not guaranteed to zero fill
+        std::streamoff position = out.tellp();
+        static const char zeros[16] = {};
+        while (position < static_cast<std::streamoff>(offset))
+        {
+            std::streamoff gap = (std::min)(static_cast<std::streamoff>(offset) - position, static_cast<std::streamoff>(sizeof(zeros)));
+            out.write(zeros, gap);
+            position += gap;
+        }
+        if (size > 0)
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    static bool stampOf(const string& sourcePath, SourceStamp& stamp)
+    {
+        std::error_code error;
+        std::filesystem::path source = std::filesystem::u8path(sourcePath);
+        uintmax_t size = std::filesystem::file_size(source, error);
+        if (error)
+            return false;
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(source, error);
+        if (error)
+            return false;
+        stamp.size = size;
+        stamp.time = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    // FNV-1a over everything the cache content depends on
+    static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::filesystem::path pathFor(const string& sourcePath, const SourceStamp& stamp, unsigned int postProcessFlags) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = hashBytes(hash, sourcePath.data(), sourcePath.size());
+        hash = hashBytes(hash, &stamp.size, sizeof(stamp.size));
+        hash = hashBytes(hash, &stamp.time, sizeof(stamp.time));
+        hash = hashBytes(hash, &postProcessFlags, sizeof(postProcessFlags));
+        uint32_t version = MESH_CACHE_VERSION;
+        hash = hashBytes(hash, &version, sizeof(version));
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.gxmc", static_cast<unsigned long long>(hash));
+        return directory / name;
+    }
+
+    static bool validate(CachedModel& model, const string& sourcePath, const SourceStamp& stamp, unsigned int postProcessFlags)
+    {
+        const char* base = model.file.data();
+        const size_t size = model.file.size();
+        if (size < sizeof(MeshCacheHeader))
+            return false;
+
+        const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(base);
+        if (std::memcmp(header->magic, "GXMC", 4) != 0 || header->version != MESH_CACHE_VERSION
+            || header->fileSize != size || header->postProcessFlags != postProcessFlags
+            || header->sourceSize != stamp.size || header->sourceTime != stamp.time)
+            return false;
+
+        const uint64_t entriesOffset = align(sizeof(MeshCacheHeader));
+        const uint64_t texturesOffset = align(entriesOffset + uint64_t(header->meshCount) * sizeof(MeshCacheEntry));
+        const uint64_t rangesOffset = align(texturesOffset + uint64_t(header->textureCount) * sizeof(MeshCacheTexture));
+        const uint64_t lodsOffset = align(rangesOffset + uint64_t(header->rangeCount) * sizeof(IndexRange));
+        const uint64_t chunksOffset = align(lodsOffset + uint64_t(header->lodCount) * sizeof(MeshLod));
+        const uint64_t stringsOffset = align(chunksOffset + uint64_t(header->chunkCount) * sizeof(MeshCacheChunk));
+        if (stringsOffset > size)
+            return false;
+        const uint64_t stringsSize = size - stringsOffset;
+
+        model.header = header;
+        model.entries = reinterpret_cast<const MeshCacheEntry*>(base + entriesOffset);
+        model.textures = reinterpret_cast<const MeshCacheTexture*>(base + texturesOffset);
+        model.ranges = reinterpret_cast<const IndexRange*>(base + rangesOffset);
+        model.lods = reinterpret_cast<const MeshLod*>(base + lodsOffset);
+        model.chunks = reinterpret_cast<const MeshCacheChunk*>(base + chunksOffset);
+        model.strings = base + stringsOffset;
+
+        if (uint64_t(header->pathOffset) + header->pathLength > stringsSize || model.text(header->pathOffset, header->pathLength) != sourcePath)
+            return false;
+        for (uint32_t i = 0; i < header->textureCount; i++)
+        {
+            const MeshCacheTexture& texture = model.textures[i];
+            if (uint64_t(texture.typeOffset) + texture.typeLength > stringsSize || uint64_t(texture.pathOffset) + texture.pathLength > stringsSize)
+                return false;
+        }
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const MeshCacheEntry& entry = model.entries[i];
+            if (entry.vertexStride != makeVertexFormat(entry.vertexFlags).stride
+                || entry.vertexOffset + uint64_t(entry.vertexCount) * entry.vertexStride > size
+                || (entry.indexType != GL_UNSIGNED_SHORT && entry.indexType != GL_UNSIGNED_INT)
+                || entry.indexOffset + uint64_t(entry.indexCount) * indexSize(entry.indexType) > size
+                || uint64_t(entry.firstRange) + entry.rangeCount > header->rangeCount
+                || uint64_t(entry.firstLod) + entry.lodCount > header->lodCount
+                || uint64_t(entry.firstTexture) + entry.textureCount > header->textureCount)
+                return false;
+            for (uint32_t l = 0; l < entry.lodCount; l++)
+            {
+                const MeshLod& lod = model.lods[entry.firstLod + l];
+                if (uint64_t(lod.firstIndex) + lod.indexCount > entry.indexCount || uint64_t(lod.firstRange) + lod.rangeCount > entry.rangeCount)
+                    return false;
+            }
+            for (uint32_t r = 0; r < entry.rangeCount; r++)
+            {
+                const IndexRange& range = model.ranges[entry.firstRange + r];
+                if (uint64_t(range.firstIndex) + range.indexCount > entry.indexCount || range.baseVertex < 0
+                    || (range.indexCount > 0 && uint32_t(range.baseVertex) >= entry.vertexCount))
+                    return false;
+            }
+        }
+        // chunks cover the entries in order, and every entry's data lies inside its chunk's block
+        uint64_t nextMesh = 0;
+        for (uint32_t c = 0; c < header->chunkCount; c++)
+        {
+            const MeshCacheChunk& chunk = model.chunks[c];
+            if (chunk.firstMesh != nextMesh || chunk.meshCount == 0 || uint64_t(chunk.firstMesh) + chunk.meshCount > header->meshCount
+                || chunk.dataOffset + chunk.dataSize > size)
+                return false;
+            for (uint32_t i = chunk.firstMesh; i < chunk.firstMesh + chunk.meshCount; i++)
+            {
+                const MeshCacheEntry& entry = model.entries[i];
+                if (entry.vertexOffset < chunk.dataOffset || entry.indexOffset + uint64_t(entry.indexCount) * indexSize(entry.indexType) > chunk.dataOffset + chunk.dataSize)
+                    return false;
+            }
+            nextMesh += chunk.meshCount;
+        }
+        return nextMesh == header->meshCount;
+    }
+
+    // deletes the least recently used cache files until the directory fits the budget again.
+    // files that are mapped right now can't be deleted on Windows and are simply skipped, and neither
+    // is keep, the file just written, even if it's bigger than the whole budget on its own.
+    void trim(const std::filesystem::path& keep)
+    {
+        struct CacheFile
+        {
+            std::filesystem::path path;
+            std::filesystem::file_time_type time;
+            uintmax_t size;
+        };
+        vector<CacheFile> files;
+        uintmax_t total = 0;
+
+        std::error_code error;
+        for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+        {
+            if (!it->is_regular_file(error) || it->path().extension() != ".gxmc")
+                continue;
+            CacheFile file{ it->path(), it->last_write_time(error), it->file_size(error) };
+            total += file.size;
+            files.push_back(file);
+        }
+        if (total <= maxBytes)
+            return;
+
+        std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.time < b.time; });
+        for (const CacheFile& file : files)
+        {
+            if (total <= maxBytes)
+                break;
+            if (file.path == keep)
+                continue;
+            if (std::filesystem::remove(file.path, error))
+                total -= file.size;
+        }
+    }
+};
+
+#endif // !MESH_CACHE_H
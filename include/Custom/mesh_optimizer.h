@@ -0,0 +1,432 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <Custom/bounds.h>
+#include <Custom/vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+// Import time mesh optimization, runs on the pool workers right after a mesh is converted:
+//   1. weld      merge vertices that only differ by float noise. STL and most OBJ exports arrive as
+//                three unshared vertices per triangle; welding them restores the index buffer.
+//   2. tipsify   reorder triangles for the post-transform vertex cache (Sander et al., "Fast Triangle
+//                Reordering for Vertex Locality and Reduced Overdraw").
+//   3. overdraw  cut the tipsified order into clusters and draw the outward facing ones first.
+//   4. fetch     renumber vertices in first use order so the vertex fetch reads the buffer front to back.
+// ACMR = vertex shader runs per triangle, ATVR = vertex shader runs per vertex, both for a FIFO cache.
+// Every working array comes from the memory resource of the mesh's own vectors, during an import that's the
+// worker's ImportArena scratch, so optimizing a mesh doesn't go to the heap for each of its temporaries.
+
+const unsigned int VERTEX_CACHE_SIZE = 16;
+// positions closer than this fraction of the mesh diagonal are welded
+const float WELD_RELATIVE_TOLERANCE = 1e-6f;
+const float WELD_UV_TOLERANCE = 1.0f / 65536.0f;
+// normals less than this far apart (cosine, ~25 degrees) are averaged, sharper edges keep their split vertices
+const float WELD_NORMAL_COS = 0.9f;
+// an overdraw cluster may be this much worse for the vertex cache than the whole mesh
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+struct MeshOptimizationStats
+{
+    size_t verticesBefore = 0, verticesAfter = 0;
+    size_t trianglesBefore = 0, trianglesAfter = 0;
+    size_t missesBefore = 0, missesAfter = 0;
+
+    void add(const MeshOptimizationStats& other)
+    {
+        verticesBefore += other.verticesBefore;
+        verticesAfter += other.verticesAfter;
+        trianglesBefore += other.trianglesBefore;
+        trianglesAfter += other.trianglesAfter;
+        missesBefore += other.missesBefore;
+        missesAfter += other.missesAfter;
+    }
+
+    float acmrBefore() const { return trianglesBefore ? float(missesBefore) / trianglesBefore : 0.0f; }
+    float acmrAfter() const { return trianglesAfter ? float(missesAfter) / trianglesAfter : 0.0f; }
+    float atvrBefore() const { return verticesBefore ? float(missesBefore) / verticesBefore : 0.0f; }
+    float atvrAfter() const { return verticesAfter ? float(missesAfter) / verticesAfter : 0.0f; }
+};
+
+// vertex shader invocations for drawing indices through a FIFO post-transform cache.
+// loadedAt is working memory with an entry per vertex: it has to be all zero and is left that way again,
+// so one buffer serves a whole series of calls and each call only costs as much as its indices.
+inline size_t simulateVertexCache(const unsigned int* indices, size_t count, std::pmr::vector<size_t>& loadedAt, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    // a vertex is cached while fewer than cacheSize misses happened since it was loaded.
+    // loadedAt holds 1 + the misses before its load, 0 for a vertex that was never loaded
+    size_t misses = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned int v = indices[i];
+        if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] >= cacheSize)
+            loadedAt[v] = ++misses;
+    }
+    for (size_t i = 0; i < count; i++)
+        loadedAt[indices[i]] = 0;
+    return misses;
+}
+
+inline size_t simulateVertexCache(const unsigned int* indices, size_t count, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE,
+                                  std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    std::pmr::vector<size_t> loadedAt(vertexCount, 0, scratch);
+    return simulateVertexCache(indices, count, loadedAt, cacheSize);
+}
+
+inline size_t countReferencedVertices(const std::pmr::vector<unsigned int>& indices, size_t vertexCount)
+{
+    std::pmr::vector<bool> used(vertexCount, false, indices.get_allocator().resource());
+    size_t count = 0;
+    for (unsigned int index : indices)
+    {
+        if (!used[index])
+        {
+            used[index] = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+// merges vertices with the same (quantized) position, uv and bones whose normals are close, averaging
+// their normals and tangents. Triangles that collapse in the process are dropped.
+inline void weldVertices(std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices, const Bounds& bounds)
+{
+    if (vertices.empty())
+        return;
+    std::pmr::memory_resource* scratch = vertices.get_allocator().resource();
+    const float diagonal = glm::length(bounds.size());
+    const float positionStep = diagonal > 0.0f ? diagonal * WELD_RELATIVE_TOLERANCE : 1e-6f;
+
+    struct Key
+    {
+        int64_t x, y, z, u, v;
+        int bones[MAX_BONE_INFLUENCE];
+        bool operator==(const Key& o) const
+        {
+            return x == o.x && y == o.y && z == o.z && u == o.u && v == o.v
+                && std::equal(bones, bones + MAX_BONE_INFLUENCE, o.bones);
+        }
+    };
+    auto keyOf = [&](const Vertex& vertex) {
+        Key key;
+        key.x = static_cast<int64_t>(std::llround(vertex.Position.x / positionStep));
+        key.y = static_cast<int64_t>(std::llround(vertex.Position.y / positionStep));
+        key.z = static_cast<int64_t>(std::llround(vertex.Position.z / positionStep));
+        key.u = static_cast<int64_t>(std::llround(vertex.TexCoords.x / WELD_UV_TOLERANCE));
+        key.v = static_cast<int64_t>(std::llround(vertex.TexCoords.y / WELD_UV_TOLERANCE));
+        std::copy(vertex.m_BoneIDs, vertex.m_BoneIDs + MAX_BONE_INFLUENCE, key.bones);
+        return key;
+    };
+    auto hashOf = [](const Key& key) {
+        uint64_t h = 14695981039346656037ull;
+        const int64_t parts[5] = { key.x, key.y, key.z, key.u, key.v };
+        for (int64_t part : parts)
+            h = (h ^ static_cast<uint64_t>(part)) * 1099511628211ull;
+        for (int bone : key.bones)
+            h = (h ^ static_cast<uint64_t>(bone)) * 1099511628211ull;
+        return h;
+    };
+
+    // welded vertices with the same hash are chained through next
+    std::pmr::unordered_map<uint64_t, unsigned int> first(scratch);
+    first.reserve(vertices.size());
+    std::pmr::vector<unsigned int> next(scratch);
+    std::pmr::vector<Key> keys(scratch);
+    std::pmr::vector<Vertex> welded(scratch);
+    std::pmr::vector<glm::vec3> normalSum(scratch), tangentSum(scratch), bitangentSum(scratch);
+    std::pmr::vector<unsigned int> remap(vertices.size(), scratch);
+    // sized for the worst case (nothing welds) up front, growing them would leave every old copy behind in a monotonic arena
+    next.reserve(vertices.size());
+    keys.reserve(vertices.size());
+    welded.reserve(vertices.size());
+    normalSum.reserve(vertices.size());
+    tangentSum.reserve(vertices.size());
+    bitangentSum.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        const Key key = keyOf(vertex);
+        const uint64_t hash = hashOf(key);
+        const float normalLength = glm::length(vertex.Normal);
+
+        unsigned int match = UINT32_MAX;
+        auto found = first.find(hash);
+        for (unsigned int candidate = found != first.end() ? found->second : UINT32_MAX; candidate != UINT32_MAX; candidate = next[candidate])
+        {
+            if (!(keys[candidate] == key))
+                continue;
+            const float sumLength = glm::length(normalSum[candidate]);
+            const bool bothFlat = normalLength == 0.0f && sumLength == 0.0f;
+            if (bothFlat || (normalLength > 0.0f && sumLength > 0.0f && glm::dot(vertex.Normal / normalLength, normalSum[candidate] / sumLength) >= WELD_NORMAL_COS))
+            {
+                match = candidate;
+                break;
+            }
+        }
+
+        if (match == UINT32_MAX)
+        {
+            match = static_cast<unsigned int>(welded.size());
+            welded.push_back(vertex);
+            keys.push_back(key);
+            normalSum.push_back(vertex.Normal);
+            tangentSum.push_back(vertex.Tangent);
+            bitangentSum.push_back(vertex.Bitangent);
+            next.push_back(found != first.end() ? found->second : UINT32_MAX);
+            first[hash] = match;
+        }
+        else
+        {
+            normalSum[match] += vertex.Normal;
+            tangentSum[match] += vertex.Tangent;
+            bitangentSum[match] += vertex.Bitangent;
+        }
+        remap[i] = match;
+    }
+
+    for (size_t i = 0; i < welded.size(); i++)
+    {
+        if (glm::dot(normalSum[i], normalSum[i]) > 0.0f)
+            welded[i].Normal = glm::normalize(normalSum[i]);
+        if (glm::dot(tangentSum[i], tangentSum[i]) > 0.0f)
+            welded[i].Tangent = glm::normalize(tangentSum[i]);
+        if (glm::dot(bitangentSum[i], bitangentSum[i]) > 0.0f)
+            welded[i].Bitangent = glm::normalize(bitangentSum[i]);
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        indices[out++] = a;
+        indices[out++] = b;
+        indices[out++] = c;
+    }
+    indices.resize(out);
+    vertices.swap(welded);
+}
+
+// Tipsify: fans around the most recently cached vertex that still has triangles left. Returns the triangle
+// order and the positions (in triangles) where it hit a dead end and had to jump, i.e. where the cache is cold.
+inline std::pmr::vector<unsigned int> tipsify(const std::pmr::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize, std::pmr::vector<size_t>& deadEnds)
+{
+    std::pmr::memory_resource* scratch = indices.get_allocator().resource();
+    const size_t triangleCount = indices.size() / 3;
+    std::pmr::vector<unsigned int> result(scratch);
+    result.reserve(indices.size());
+    deadEnds.clear();
+    if (triangleCount == 0)
+        return result;
+
+    // vertex -> triangle adjacency
+    std::pmr::vector<unsigned int> live(vertexCount, 0, scratch);
+    for (unsigned int index : indices)
+        live[index]++;
+    std::pmr::vector<size_t> offsets(vertexCount + 1, 0, scratch);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::pmr::vector<unsigned int> adjacency(indices.size(), scratch);
+    {
+        std::pmr::vector<size_t> fill(offsets.begin(), offsets.end() - 1, scratch);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::pmr::vector<size_t> cacheTime(vertexCount, 0, scratch);
+    std::pmr::vector<bool> emitted(triangleCount, false, scratch);
+    std::pmr::vector<unsigned int> deadEndStack(scratch);
+    std::pmr::vector<unsigned int> candidates(scratch);
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    long long fanning = indices[0];
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (size_t a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            const unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                const unsigned int v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                deadEndStack.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // prefer the candidate that stays in the cache longest while we fan around it
+        long long best = -1;
+        long long bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            long long priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = static_cast<long long>(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        if (best < 0)
+        {
+            // dead end: back up through recently used vertices, then scan for anything left
+            while (!deadEndStack.empty() && best < 0)
+            {
+                const unsigned int v = deadEndStack.back();
+                deadEndStack.pop_back();
+                if (live[v] > 0)
+                    best = v;
+            }
+            while (best < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    best = static_cast<long long>(cursor);
+                cursor++;
+            }
+            if (best >= 0)
+                deadEnds.push_back(result.size() / 3);
+        }
+        fanning = best;
+    }
+    return result;
+}
+
+// cuts the tipsified order into clusters at dead ends, as long as a cluster on its own (cold cache)
+// doesn't get much worse than the mesh as a whole, then sorts the clusters so the ones facing away
+// from the center are drawn first. They tend to occlude the rest, whatever the view direction.
+inline void optimizeOverdraw(std::pmr::vector<unsigned int>& indices, const std::pmr::vector<Vertex>& vertices, const std::pmr::vector<size_t>& deadEnds, unsigned int cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || deadEnds.empty())
+        return;
+    // shared by all the cluster simulations, one buffer per cluster would pile up in a monotonic scratch resource
+    std::pmr::memory_resource* scratch = indices.get_allocator().resource();
+    std::pmr::vector<size_t> loadedAt(vertices.size(), 0, scratch);
+    const float meshAcmr = float(simulateVertexCache(indices.data(), indices.size(), loadedAt, cacheSize)) / triangleCount;
+
+    std::pmr::vector<size_t> clusters(1, 0, scratch);
+    for (size_t boundary : deadEnds)
+    {
+        const size_t start = clusters.back();
+        if (boundary <= start || boundary >= triangleCount)
+            continue;
+        const size_t misses = simulateVertexCache(indices.data() + start * 3, (boundary - start) * 3, loadedAt, cacheSize);
+        if (float(misses) / (boundary - start) <= meshAcmr * OVERDRAW_ACMR_THRESHOLD)
+            clusters.push_back(boundary);
+    }
+    if (clusters.size() < 2)
+        return;
+    clusters.push_back(triangleCount);
+
+    glm::vec3 meshCenter(0.0f);
+    for (const Vertex& vertex : vertices)
+        meshCenter += vertex.Position;
+    meshCenter /= float(vertices.size());
+
+    struct Cluster
+    {
+        size_t start, end;
+        float sortKey;
+    };
+    std::pmr::vector<Cluster> sorted(scratch);
+    sorted.reserve(clusters.size() - 1);
+    for (size_t c = 0; c + 1 < clusters.size(); c++)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+            const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const float triangleArea = glm::length(cross);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        float key = 0.0f;
+        const float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            key = glm::dot(centroid / area - meshCenter, normal / normalLength);
+        sorted.push_back(Cluster{ clusters[c], clusters[c + 1], key });
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::pmr::vector<unsigned int> reordered(scratch);
+    reordered.reserve(indices.size());
+    for (const Cluster& cluster : sorted)
+        reordered.insert(reordered.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    indices.swap(reordered);
+}
+
+// renumbers vertices in the order the index buffer first touches them and drops unreferenced ones
+inline void optimizeVertexFetch(std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices)
+{
+    std::pmr::memory_resource* scratch = vertices.get_allocator().resource();
+    std::pmr::vector<unsigned int> remap(vertices.size(), UINT32_MAX, scratch);
+    std::pmr::vector<Vertex> ordered(scratch);
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+// full pipeline for one triangle mesh, returns the cache statistics before and after
+inline MeshOptimizationStats optimizeMesh(std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices, const Bounds& bounds)
+{
+    std::pmr::memory_resource* scratch = vertices.get_allocator().resource();
+    MeshOptimizationStats stats;
+    stats.trianglesBefore = indices.size() / 3;
+    stats.verticesBefore = countReferencedVertices(indices, vertices.size());
+    stats.missesBefore = simulateVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE, scratch);
+    if (indices.empty() || indices.size() % 3 != 0)
+    {
+        stats.trianglesAfter = stats.trianglesBefore;
+        stats.verticesAfter = stats.verticesBefore;
+        stats.missesAfter = stats.missesBefore;
+        return stats;
+    }
+
+    weldVertices(vertices, indices, bounds);
+    std::pmr::vector<size_t> deadEnds(scratch);
+    indices = tipsify(indices, vertices.size(), VERTEX_CACHE_SIZE, deadEnds);
+    optimizeOverdraw(indices, vertices, deadEnds, VERTEX_CACHE_SIZE);
+    optimizeVertexFetch(vertices, indices);
+
+    stats.trianglesAfter = indices.size() / 3;
+    stats.verticesAfter = vertices.size();
+    stats.missesAfter = simulateVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE, scratch);
+    return stats;
+}
+
+#endif // !MESH_OPTIMIZER_H
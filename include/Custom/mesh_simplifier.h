@@ -0,0 +1,293 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <Custom/index_format.h>
+#include <Custom/mesh_optimizer.h>
+#include <Custom/vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+// Level of detail generation with quadric error metrics (Garland & Heckbert).
+// Every LOD only drops triangles and reuses the vertices of the full mesh, so all levels share one
+// vertex buffer and a LOD is just another run of the index buffer (see MeshLod).
+// Collapses move a vertex onto one of its neighbours, never to a new position. Vertices on open borders
+// and on attribute seams (same position, different normal/uv) are never moved, so LODs don't tear.
+
+// including the full mesh, so up to 4 simplified levels
+const unsigned int MAX_LOD_COUNT = 5;
+// each level aims for this fraction of the triangles of the previous one
+const float LOD_REDUCTION = 0.5f;
+// meshes below this don't get simplified levels, and a level that would go below it isn't built
+const size_t LOD_MIN_TRIANGLES = 128;
+
+// symmetric 4x4 error quadric, sum of squared distances to a set of planes
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    void addPlane(double a, double b, double c, double d)
+    {
+        a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+        b2 += b * b; bc += b * c; bd += b * d;
+        c2 += c * c; cd += c * d;
+        d2 += d * d;
+    }
+
+    Quadric& operator+=(const Quadric& o)
+    {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+        b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd;
+        d2 += o.d2;
+        return *this;
+    }
+
+    double evaluate(const glm::vec3& p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+             + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+             + c2 * z * z + 2 * cd * z
+             + d2;
+    }
+};
+
+// collapses edges of indices (in place) until at most targetTriangles are left or nothing can collapse anymore.
+// quadrics are updated as vertices merge so a chain of calls keeps accumulating the error; error receives the
+// largest collapse error so far as a distance in object space.
+inline void simplifyIndices(const std::pmr::vector<Vertex>& vertices, const std::pmr::vector<unsigned char>& locked, std::pmr::vector<Quadric>& quadrics,
+                            std::pmr::vector<unsigned int>& indices, size_t targetTriangles, float& error)
+{
+    struct Collapse
+    {
+        double cost;
+        unsigned int from, to;
+    };
+    const size_t vertexCount = vertices.size();
+    // allocated once and reused by every pass, so a monotonic scratch resource doesn't grow with the pass count
+    std::pmr::memory_resource* scratch = indices.get_allocator().resource();
+    std::pmr::vector<size_t> offsets(vertexCount + 1, scratch);
+    std::pmr::vector<size_t> fill(scratch);
+    std::pmr::vector<unsigned int> adjacency(scratch);
+    std::pmr::vector<uint64_t> edges(scratch);
+    std::pmr::vector<Collapse> collapses(scratch);
+    std::pmr::vector<unsigned char> touched(vertexCount, scratch);
+    std::pmr::vector<unsigned char> dead(scratch);
+    // at most one edge per triangle corner, the collapses are sized once the first pass knows the unique edges
+    edges.reserve(indices.size());
+
+    // every pass collapses a set of edges that don't share a neighbourhood, then rebuilds everything
+    for (int pass = 0; pass < 64 && indices.size() / 3 > targetTriangles; pass++)
+    {
+        const size_t triangleCount = indices.size() / 3;
+
+        // vertex -> triangle adjacency
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (unsigned int index : indices)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(indices.size());
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+        // unique edges and the cheaper valid direction of each
+        edges.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                const unsigned int a = indices[t * 3 + e], b = indices[t * 3 + (e + 1) % 3];
+                edges.push_back(a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        collapses.reserve(edges.size());
+        for (uint64_t edge : edges)
+        {
+            const unsigned int a = static_cast<unsigned int>(edge >> 32), b = static_cast<unsigned int>(edge & 0xffffffffu);
+            Quadric merged = quadrics[a];
+            merged += quadrics[b];
+            const double toB = locked[a] ? -1.0 : (std::max)(merged.evaluate(vertices[b].Position), 0.0);
+            const double toA = locked[b] ? -1.0 : (std::max)(merged.evaluate(vertices[a].Position), 0.0);
+            if (toB >= 0.0 && (toA < 0.0 || toB <= toA))
+                collapses.push_back(Collapse{ toB, a, b });
+            else if (toA >= 0.0)
+                collapses.push_back(Collapse{ toA, b, a });
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        dead.assign(triangleCount, 0);
+        size_t removed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (triangleCount - removed <= targetTriangles)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // moving from onto to must not flip any triangle that keeps existing
+            const glm::vec3& target = vertices[collapse.to].Position;
+            bool flips = false;
+            for (size_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++)
+            {
+                const unsigned int* tri = &indices[adjacency[a] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                    continue;
+                const int corner = tri[0] == collapse.from ? 0 : (tri[1] == collapse.from ? 1 : 2);
+                const glm::vec3& p1 = vertices[tri[(corner + 1) % 3]].Position;
+                const glm::vec3& p2 = vertices[tri[(corner + 2) % 3]].Position;
+                const glm::vec3 before = glm::cross(p1 - vertices[collapse.from].Position, p2 - vertices[collapse.from].Position);
+                const glm::vec3 after = glm::cross(p1 - target, p2 - target);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            for (size_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+            {
+                const unsigned int t = adjacency[a];
+                unsigned int* tri = &indices[t * 3];
+                for (int corner = 0; corner < 3; corner++)
+                    tri[corner] = tri[corner] == collapse.from ? collapse.to : tri[corner];
+                if (!dead[t] && (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]))
+                {
+                    dead[t] = 1;
+                    removed++;
+                }
+            }
+            quadrics[collapse.to] += quadrics[collapse.from];
+            error = (std::max)(error, static_cast<float>(std::sqrt(collapse.cost)));
+
+            // the whole neighbourhood is stale now, leave it for the next pass
+            for (unsigned int v : { collapse.from, collapse.to })
+            {
+                for (size_t a = offsets[v]; a < offsets[v + 1]; a++)
+                {
+                    const unsigned int* tri = &indices[adjacency[a] * 3];
+                    touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+                }
+            }
+        }
+        if (removed == 0)
+            break;
+
+        size_t out = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            if (dead[t])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+                indices[out++] = indices[t * 3 + corner];
+        }
+        indices.resize(out);
+    }
+}
+
+// appends simplified levels to indices. lods receives the full mesh as level 0 followed by every level
+// that was built, each pointing at its own run of indices.
+inline void buildLods(const std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices, std::vector<MeshLod>& lods)
+{
+    lods.clear();
+    lods.push_back(MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0, 0, 0.0f });
+    if (indices.size() / 3 < LOD_MIN_TRIANGLES * 2 || indices.size() % 3 != 0)
+        return;
+
+    std::pmr::memory_resource* scratch = indices.get_allocator().resource();
+
+    // plane quadrics of the full mesh
+    std::pmr::vector<Quadric> quadrics(vertices.size(), scratch);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const glm::vec3& p0 = vertices[indices[i]].Position;
+        const glm::vec3& p1 = vertices[indices[i + 1]].Position;
+        const glm::vec3& p2 = vertices[indices[i + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normal /= length;
+        Quadric plane;
+        plane.addPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+        for (int corner = 0; corner < 3; corner++)
+            quadrics[indices[i + corner]] += plane;
+    }
+
+    // lock border vertices (edges with one triangle) and seam vertices (position shared with another vertex)
+    std::pmr::vector<unsigned char> locked(vertices.size(), 0, scratch);
+    {
+        std::pmr::vector<uint64_t> edges(scratch);
+        edges.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                const unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+                edges.push_back(a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i])
+                j++;
+            if (j - i == 1)
+                locked[edges[i] >> 32] = locked[edges[i] & 0xffffffffu] = 1;
+            i = j;
+        }
+
+        std::pmr::unordered_map<uint64_t, unsigned int> byPosition(scratch);
+        byPosition.reserve(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            const glm::vec3& p = vertices[v].Position;
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            const uint64_t key = (uint64_t(bits[0]) * 73856093u) ^ (uint64_t(bits[1]) * 19349663u << 16) ^ (uint64_t(bits[2]) * 83492791u << 32);
+            auto found = byPosition.find(key);
+            if (found == byPosition.end())
+                byPosition.emplace(key, static_cast<unsigned int>(v));
+            else if (vertices[found->second].Position == p)
+                locked[v] = locked[found->second] = 1;
+        }
+    }
+
+    std::pmr::vector<unsigned int> current(indices, scratch);
+    std::pmr::vector<size_t> deadEnds(scratch);
+    // every level has at most LOD_REDUCTION of the previous one's triangles, so all of them fit in another full mesh worth
+    indices.reserve(indices.size() * 2);
+    float error = 0.0f;
+    for (unsigned int level = 1; level < MAX_LOD_COUNT; level++)
+    {
+        const size_t previous = current.size() / 3;
+        const size_t target = static_cast<size_t>(previous * LOD_REDUCTION);
+        if (target < LOD_MIN_TRIANGLES)
+            break;
+        simplifyIndices(vertices, locked, quadrics, current, target, error);
+        // stuck on locked vertices, another level would look the same
+        if (current.size() / 3 > previous * 0.85f)
+            break;
+
+        std::pmr::vector<unsigned int> ordered = tipsify(current, vertices.size(), VERTEX_CACHE_SIZE, deadEnds);
+        lods.push_back(MeshLod{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(ordered.size()), 0, 0, error });
+        indices.insert(indices.end(), ordered.begin(), ordered.end());
+    }
+}
+
+#endif // !MESH_SIMPLIFIER_H
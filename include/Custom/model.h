@@ -9,156 +9,693 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/ProgressHandler.hpp>
 
+#include <Custom/geometry_arena.h>
+#include <Custom/geometry_pager.h>
+#include <Custom/import_arena.h>
 #include <Custom/mesh.h>
+#include <Custom/mesh_cache.h>
+#include <Custom/mesh_optimizer.h>
+#include <Custom/mesh_simplifier.h>
 #include <Custom/shader_s.h>
+#include <Custom/texture_cache.h>
+#include <Custom/thread_pool.h>
 
 #include <string>
+#include <cfloat>
+#include <chrono>
+#include <deque>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <atomic>
 #include <map>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
-glm::vec3 Min = glm::vec3(FLT_MAX);
-glm::vec3 Max = glm::vec3(-FLT_MAX);
+// length of a dithered cross-fade between two levels of detail
+const float LOD_FADE_SECONDS = 0.25f;
+
+// post-processing applied to every import. Part of the mesh cache key, so changing it invalidates old cache files.
+const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes;
+
+// shared between a running import and whoever watches it (the UI). Reading: 0-60%, converting: 60-95%, upload: the rest.
+struct ImportProgress
+{
+    std::atomic<float> fraction{ 0.0f };
+    std::atomic<bool> cancelRequested{ false };
+};
+
+// forwards Assimp's read/post-process progress and aborts ReadFile once a cancel was requested
+class ImportProgressHandler : public Assimp::ProgressHandler
+{
+public:
+    explicit ImportProgressHandler(ImportProgress& progress) : progress(progress) {}
+
+    bool Update(float percentage) override
+    {
+        if (percentage >= 0.0f)
+            progress.fraction = (std::min)(percentage, 1.0f) * 0.6f;
+        return !progress.cancelRequested;
+    }
+
+private:
+    ImportProgress& progress;
+};
+
 class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    unordered_map<string, unsigned int> textures_loaded;	// path -> texture, each one acquired once from the TextureCache and released with the model
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // submit one glMultiDrawElementsBaseVertex per material instead of a draw per mesh
+    bool multiDraw = true;
+    // level of detail: a level is used while its error stays under lodPixelError pixels on screen,
+    // and the allowed error grows until the whole model fits triangleBudget
+    float lodPixelError = 1.0f;
+    size_t triangleBudget = 4000000;
+    bool lodCrossFade = false;
+    // geometry bigger than the GPU budget is paged in from the mesh cache file instead of uploaded as a whole.
+    // Only read by prepare() for that decision, both budgets can be changed at any time afterwards.
+    uint64_t gpuGeometryBudget = PAGING_GPU_BUDGET_BYTES;
+    uint64_t cpuGeometryBudget = PAGING_CPU_BUDGET_BYTES;
+    // CpuGeometryUse bits of whoever needs Mesh::vertices/indices after the upload, set before prepare().
+    // The mesh cache only holds packed data, so a registered use also means the file goes through Assimp and isn't paged.
+    unsigned int cpuGeometryUses = 0;
 
-    glm::vec3 modelCenter;
-    float modelWidth, modelHeight;
+    // bounds of this model only, every import starts from scratch
+    Bounds bounds;
+    BoundingSphere sphere;
+    glm::vec3 modelCenter = glm::vec3(0.0f);
+    float modelWidth = 0.0f, modelHeight = 0.0f;
 
-    // constructor, expects a filepath to a 3D model.
+    // constructor, expects a filepath to a 3D model. Reads and uploads in one go, so it has to run on the GL thread.
     Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
-        modelCenter = (Min + Max) / 2.0f;
-        modelWidth = Max.x - Min.x;
-        modelHeight = Max.y - Min.y;
+        if (prepare(path))
+            finish();
+    }
+
+    // empty model for two step loading: prepare() on any thread, then pump()/finish() on the GL thread.
+    Model() : gammaCorrection(false)
+    {
+    }
+
+    // textures are shared process wide, hand ours back so the cache can free the ones nobody else uses
+    ~Model()
+    {
+        for (const auto& texture : textures_loaded)
+            TextureCache::instance().release(texture.second);
+        deleteBoxes();
+    }
+
+    // a copy would release the same textures twice
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // reads and converts the file without touching GL. Returns false if the file couldn't be read or the import was cancelled.
+    // Converted meshes are handed over one by one while this runs, see pump().
+    bool prepare(string const& path, ImportProgress* progress = nullptr)
+    {
+        ImportProgress ignored;
+        return loadModel(path, progress != nullptr ? *progress : ignored);
+    }
+
+    // prepare() got far enough to show something: the bounds are set and pump() may be called
+    bool previewReady() const { return hasPreview; }
+
+    // the geometry is paged in and out by selectLods() instead of being uploaded once
+    bool paged() const { return pagingReady; }
+
+    // LOD fades or paging are still in progress, the next frames change even if the view stays put
+    bool animating() const
+    {
+        for (const Mesh& mesh : meshes)
+        {
+            if (mesh.fading())
+                return true;
+        }
+        return pagingReady && pager->busy();
+    }
+
+    void requireCpuGeometry(CpuGeometryUse use) { cpuGeometryUses |= use; }
+    bool keepsCpuGeometry() const { return cpuGeometryUses != 0; }
+
+    // GL thread only, may run while prepare() is still busy on another thread. Uploads what prepare() handed over
+    // so far, spending about budgetMs on it: every mesh shows as a box first, then as its coarsest level, then in full.
+    // The full meshes go into pools sized for all of them at once, so they wait until every size is known: right
+    // away for a cached model, once the conversion is done for one that went through Assimp.
+    void pump(float budgetMs)
+    {
+        if (!hasPreview)
+            return;
+        if (boxStart.empty() && !sceneBounds.empty())
+            uploadBoxes();
+        if (!sized && prepared)
+            reservePending();
+
+        // as many arrivals as the measured upload rate says fit into the budget, but always at least one
+        vector<Arrival> taken;
+        size_t bytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(arrivals.lock);
+            const double allowed = static_cast<double>(budgetMs) * uploadRate;
+            while (taken.empty() || bytes < allowed)
+            {
+                Arrival arrival;
+                if (!arrivals.previews.empty())
+                {
+                    arrival = Arrival{ arrivals.previews.front(), true };
+                    arrivals.previews.pop_front();
+                }
+                else if (sized && !arrivals.meshes.empty())
+                {
+                    arrival = Arrival{ arrivals.meshes.front(), false };
+                    arrivals.meshes.pop_front();
+                }
+                else
+                {
+                    break;
+                }
+                bytes += arrivalBytes(arrival);
+                taken.push_back(arrival);
+            }
+        }
+        if (taken.empty())
+            return;
+
+        const auto started = std::chrono::steady_clock::now();
+        uploadArrivals(taken);
+        glFlush();
+        const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - started).count();
+        if (elapsed > 0.1f)
+            uploadRate = uploadRate * 0.75 + bytes / elapsed * 0.25;
+
+        buildBatches();
+        refreshBoxes();
+    }
+
+    // GL thread only. prepare() returned true and pump() has nothing left to upload, finish() won't stall a frame.
+    bool uploaded() const
+    {
+        return pagingReady || (prepared && sized && arrivals.previews.empty() && arrivals.meshes.empty());
+    }
+
+    // GL thread only, after prepare() returned true: settles the model into its final state. Whatever pump()
+    // hasn't uploaded yet is uploaded here in one go, which only the blocking constructor should rely on.
+    void finish()
+    {
+        // paged geometry stays in the cache file, selectLods() brings in what the view needs
+        if (pagingReady)
+        {
+            vector<MeshData>().swap(pending);
+            vector<MeshData>().swap(previews);
+            return;
+        }
+
+        // boxes that haven't been built yet never will be
+        vector<Bounds>().swap(sceneBounds);
+        while (!uploaded())
+            pump(FLT_MAX);
+
+        vector<MeshData>().swap(pending);
+        vector<MeshData>().swap(previews);
+        vector<GeometryArena::Slice>().swap(meshSlices);
+        cachedPending.reset();
+        // every preview has been replaced by its full mesh, their buffers go
+        previewArena.reset();
+        buildBatches();
+        deleteBoxes();
+
+        bounds = Bounds();
+        for (const Mesh& mesh : meshes)
+            bounds.extend(mesh.bounds);
+        sphere = bounds.sphere();
+        modelCenter = bounds.center();
+        modelWidth = bounds.size().x;
+        modelHeight = bounds.size().y;
+    }
+
+    // picks the level of detail of every mesh for this frame from its projected bounding sphere.
+    // modelMatrix/view/projection are the matrices the shaders get, viewportHeight is in pixels.
+    // A paged model first brings the chunks this view needs onto the GPU, by the same on-screen size measure.
+    void selectLods(const glm::mat4& modelMatrix, const glm::mat4& view, const glm::mat4& projection, float viewportHeight, float deltaTime)
+    {
+        const glm::mat4 modelView = view * modelMatrix;
+        const float scale = (std::max)(glm::length(glm::vec3(modelMatrix[0])), (std::max)(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        // pixels covered by one object space unit at distance 1
+        const float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f * scale;
+
+        if (pagingReady)
+            page(projection * modelView, modelView, scale, pixelsPerUnit);
+
+        selectedLods.resize(meshes.size());
+        float threshold = lodPixelError;
+        for (int attempt = 0; attempt < 16; attempt++)
+        {
+            size_t triangles = 0;
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                const unsigned int level = levelFor(meshes[i], modelView, scale, pixelsPerUnit, threshold);
+                selectedLods[i] = level;
+                triangles += meshes[i].lods[level].indexCount / 3;
+            }
+            if (triangles <= triangleBudget)
+                break;
+            threshold *= 2.0f;
+        }
+
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            Mesh& mesh = meshes[i];
+            if (selectedLods[i] != mesh.lod)
+            {
+                mesh.fadingFrom = mesh.lod;
+                mesh.fade = lodCrossFade ? 0.0f : 1.0f;
+                mesh.lod = selectedLods[i];
+            }
+            else if (mesh.fade < 1.0f)
+            {
+                mesh.fade = (std::min)(mesh.fade + deltaTime / LOD_FADE_SECONDS, 1.0f);
+            }
+        }
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader& shader, Shader& blueShader)
     {
+        // meshes of a running import that aren't uploaded yet show as their bounding box
+        if (!boxFirst.empty())
+            drawBoxes(blueShader);
+        // one submission per material and vertex layout, or the old draw per mesh if the driver lacks multi-draw.
+        // meshes in the middle of a LOD cross-fade need their own uniforms and are drawn one by one afterwards.
+        // A paged model's meshes live in one arena per chunk, the batches only cover the model's own arena.
+        if (multiDraw && !pagingReady && glMultiDrawElementsBaseVertex != NULL && !batches.empty())
+        {
+            refreshBatches();
+            for (const DrawBatch& batch : batches)
+            {
+                if (!batch.counts.empty())
+                    drawBatch(batch, shader);
+            }
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                if (meshes[i].fading() || meshPreview[i])
+                    meshes[i].Draw(shader);
+            }
+            return;
+        }
         for (unsigned int i = 0; i < meshes.size(); i++) {
-            meshes[i].Draw(shader, blueShader);
+            meshes[i].Draw(shader);
         }
     }
 
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const& path)
+    // finest level of mesh whose error stays under threshold pixels on screen
+    unsigned int levelFor(const Mesh& mesh, const glm::mat4& modelView, float scale, float pixelsPerUnit, float threshold) const
     {
+        const float distance = -(modelView * glm::vec4(mesh.sphere.center, 1.0f)).z;
+        const float radius = mesh.sphere.radius * scale;
+        unsigned int level = 0;
+        if (distance < -radius)
+        {
+            // completely behind the camera
+            level = static_cast<unsigned int>(mesh.lods.size() - 1);
+        }
+        else if (distance > radius)
+        {
+            const float pixels = pixelsPerUnit / distance;
+            while (level + 1 < mesh.lods.size() && mesh.lods[level + 1].error * pixels <= threshold)
+                level++;
+        }
+        return level;
+    }
+
+    // one vertex and index buffer per vertex layout for all meshes, and the batches drawn from them
+    GeometryArena arena;
+    vector<GeometryArena::Slice> meshSlices;   // every scene mesh's slice of arena, reserved before the first full mesh is uploaded
+    // the previews of a running import live apart from the meshes that replace them and go with finish()
+    unique_ptr<GeometryArena> previewArena;
+    vector<DrawBatch> batches;
+    vector<size_t> meshBatch;       // batch of every mesh
+    vector<unsigned int> selectedLods;
+
+    // converted meshes waiting for pump(), either freshly converted or still inside the mapped cache file.
+    // Indexed by scene mesh; the workers fill them in and announce each one through arrivals.
+    vector<MeshData> pending;
+    vector<MeshData> previews;      // coarsest level of every pending mesh, uploaded ahead of it
+    unique_ptr<CachedModel> cachedPending;
+    // only for paged models, reads from cachedPending so it has to go first
+    unique_ptr<GeometryPager> pager;
+    std::atomic<bool> pagingReady{ false };
+    bool pagedBoxes = false;
+
+    // a converted mesh ready for upload: its scene mesh, and whether it's the preview or the real thing
+    struct Arrival
+    {
+        size_t mesh;
+        bool preview;
+    };
+    struct ArrivalQueue
+    {
+        std::mutex lock;
+        std::deque<size_t> previews;
+        std::deque<size_t> meshes;
+    };
+    ArrivalQueue arrivals;
+    std::atomic<bool> hasPreview{ false };
+    std::atomic<bool> prepared{ false };    // prepare() succeeded, pending and arrivals belong to the GL thread alone
+    bool sized = false;             // meshSlices is filled in, full meshes can be uploaded
+    double uploadRate = 64.0 * 1024.0;  // bytes per millisecond, measured by pump()
+
+    // progressive display: a box per scene mesh until the mesh itself is uploaded
+    vector<Bounds> sceneBounds;
+    vector<long long> meshSlot;     // scene mesh (cache entry when paged) -> index into meshes, -1 while it isn't uploaded
+    vector<bool> meshPreview;       // per entry of meshes: it's still a preview, drawn on its own from previewArena
+    vector<GLint> boxStart;         // first line vertex of every scene mesh's box, -1 if it has none
+    vector<GLint> boxFirst;         // boxes still to draw, for glMultiDrawArrays
+    vector<GLsizei> boxCount;
+    GLVertexArray boxVAO;
+    GLBuffer boxVBO;
+
+    // loads a model with supported ASSIMP extensions from file and hands the converted meshes over to pump().
+    bool loadModel(string const& path, ImportProgress& progress)
+    {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // an up to date cache file lets us skip Assimp and upload straight from the mapping
+        unique_ptr<CachedModel> cached(new CachedModel());
+        if (!keepsCpuGeometry() && MeshCache::instance().load(path, IMPORT_FLAGS, *cached))
+        {
+            const uint32_t meshCount = cached->header->meshCount;
+            sceneBounds.resize(meshCount);
+            for (uint32_t i = 0; i < meshCount; i++)
+                sceneBounds[i] = cachedBounds(cached->entries[i]);
+            cachedPending = std::move(cached);
+            if (cachedPending->file.size() > gpuGeometryBudget)
+                startPaging();
+            // the header has every mesh's size, the pools are sized before the GL thread may start pumping
+            if (!pagingReady)
+                reserveCached();
+            publishBounds();
+            if (!pagingReady)
+                queueAll(meshCount);
+            progress.fraction = 0.95f;
+            prepared = true;
+            return true;
+        }
+
+        const auto started = std::chrono::steady_clock::now();
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes);
-        //const aabb &aabb = scene->mMeshes[0]->mAABB;
+        ImportProgressHandler progressHandler(progress);
+        importer.SetProgressHandler(&progressHandler);
+        const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+        importer.SetProgressHandler(nullptr); // hand the handler back, the importer must not delete it
 
+        if (progress.cancelRequested)
+            return false;
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return false;
+        }
+
+        // flatten the node hierarchy first so the conversion can be spread over the thread pool
+        vector<const aiMesh*> sceneMeshes;
+        sceneMeshes.reserve(scene->mNumMeshes);
+        processNode(scene->mRootNode, scene, sceneMeshes);
+
+        // aiProcess_GenBoundingBoxes gave us every box already, enough to put something on screen right away
+        sceneBounds.resize(sceneMeshes.size());
+        for (size_t i = 0; i < sceneMeshes.size(); i++)
+        {
+            const aiAABB& box = sceneMeshes[i]->mAABB;
+            if (sceneMeshes[i]->mNumVertices == 0)
+                continue;
+            sceneBounds[i].min = glm::vec3(box.mMin.x, box.mMin.y, box.mMin.z);
+            sceneBounds[i].max = glm::vec3(box.mMax.x, box.mMax.y, box.mMax.z);
+        }
+        pending.resize(sceneMeshes.size());
+        previews.resize(sceneMeshes.size());
+        publishBounds();
+
+        // a model that clearly won't fit the GPU isn't uploaded while it converts, it's paged from the cache file afterwards
+        uint64_t estimate = 0;
+        for (const aiMesh* mesh : sceneMeshes)
+            estimate += uint64_t(mesh->mNumVertices) * 24 + uint64_t(mesh->mNumFaces) * 3 * sizeof(uint32_t);
+        const bool wantPaging = estimate > gpuGeometryBudget && !keepsCpuGeometry();
+
+        // convert every mesh on the workers (CPU only), pump() picks each one up on the GL thread as soon as it's done
+        vector<MeshOptimizationStats> optimization(sceneMeshes.size());
+        std::atomic<size_t> done(0);
+        // the temporaries of every conversion come from here, freed all at once when loadModel returns
+        ImportArena scratch;
+        ThreadPool::instance().parallelFor(sceneMeshes.size(), [&](size_t i) {
+            if (progress.cancelRequested)
+                return;
+            ImportArena::Scope arena(scratch);
+            pending[i] = processMesh(sceneMeshes[i], scene, optimization[i], arena.resource(), &previews[i]);
+            if (!wantPaging)
+            {
+                std::lock_guard<std::mutex> lock(arrivals.lock);
+                if (previews[i].indexCount > 0)
+                    arrivals.previews.push_back(i);
+                arrivals.meshes.push_back(i);
+            }
+            progress.fraction = 0.6f + 0.35f * (++done) / sceneMeshes.size();
+        });
+        if (progress.cancelRequested)
+            return false;
+        // everything needed was copied out, give the scene's memory back before the cache write
+        importer.FreeScene();
+
+        MeshOptimizationStats total;
+        for (const MeshOptimizationStats& stats : optimization)
+            total.add(stats);
+        cout << "MESH OPTIMIZER: vertices " << total.verticesBefore << " -> " << total.verticesAfter
+             << ", ACMR " << total.acmrBefore() << " -> " << total.acmrAfter()
+             << ", ATVR " << total.atvrBefore() << " -> " << total.atvrAfter() << '\n';
+        cout << "IMPORT: " << sceneMeshes.size() << " meshes in "
+             << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - started).count() << " ms, "
+             << scratch.allocations() << " scratch allocations, " << scratch.heapAllocations() << " of them from the heap ("
+             << scratch.heapBytes() / (1024 * 1024) << " MB)" << '\n';
+        MeshCache::instance().store(path, IMPORT_FLAGS, pending);
+
+        if (wantPaging)
+        {
+            unique_ptr<CachedModel> stored(new CachedModel());
+            if (MeshCache::instance().load(path, IMPORT_FLAGS, *stored))
+            {
+                // the file has it all now, drop the converted copies before they're ever uploaded
+                cachedPending = std::move(stored);
+                vector<MeshData>().swap(pending);
+                vector<MeshData>().swap(previews);
+                startPaging();
+            }
+            else
+            {
+                cout << "ERROR::MODEL:: no mesh cache to page from, uploading everything" << endl;
+                queueAll(pending.size());
+            }
+        }
+        prepared = true;
+        return true;
+    }
+
+    // reserves a slice of arena for every full mesh of the cache file, so each pool is allocated once at its final size
+    void reserveCached()
+    {
+        meshSlices.resize(cachedPending->header->meshCount);
+        for (size_t i = 0; i < meshSlices.size(); i++)
+        {
+            const MeshCacheEntry& entry = cachedPending->entries[i];
+            meshSlices[i] = arena.reserve(makeVertexFormat(entry.vertexFlags), entry.indexType, entry.vertexCount, entry.indexCount);
+        }
+        sized = true;
+    }
+
+    // GL thread only, once prepare() is done: the same for converted meshes, whose sizes are only known now
+    void reservePending()
+    {
+        // the full meshes are all converted, previews still waiting would only be replaced right away
+        arrivals.previews.clear();
+        meshSlices.resize(pending.size());
+        for (size_t i = 0; i < pending.size(); i++)
+            meshSlices[i] = arena.reserve(pending[i].format, pending[i].indexType, pending[i].vertexCount, pending[i].indexCount);
+        sized = true;
+    }
+
+    // hands every mesh over to pump() at once
+    void queueAll(size_t count)
+    {
+        std::lock_guard<std::mutex> lock(arrivals.lock);
+        for (size_t i = 0; i < count; i++)
+            arrivals.meshes.push_back(i);
+    }
+
+    void startPaging()
+    {
+        pager.reset(new GeometryPager(*cachedPending));
+        pagingReady = true;
+    }
+
+    // GL thread only: pages chunks for this view and updates the meshes when the resident set changed
+    void page(const glm::mat4& modelViewProjection, const glm::mat4& modelView, float scale, float pixelsPerUnit)
+    {
+        // from here on a box stands for a chunk that isn't on the GPU
+        if (!pagedBoxes)
+        {
+            deleteBoxes();
+            sceneBounds.resize(pager->chunkCount());
+            for (size_t c = 0; c < pager->chunkCount(); c++)
+                sceneBounds[c] = pager->chunkBounds(c);
+            uploadBoxes();
+            pagedBoxes = true;
+        }
+        if (!pager->update(modelViewProjection, modelView, scale, pixelsPerUnit, cpuGeometryBudget, gpuGeometryBudget))
             return;
+
+        // meshes of chunks that stayed on the GPU are kept, and with them their level of detail and fade. update()
+        // never evicts and uploads the same chunk at once, so their slices are still good. Newly arrived meshes
+        // start at the level the view asks for, a fade from level 0 would only flicker.
+        vector<Mesh> resident;
+        resident.reserve(meshes.size());
+        vector<long long> residentSlot(meshSlot.size(), -1);
+        for (size_t c = 0; c < pager->chunkCount(); c++)
+        {
+            if (!pager->onGpu(c))
+                continue;
+            const MeshCacheChunk& chunk = pager->chunk(c);
+            for (uint32_t m = chunk.firstMesh; m < chunk.firstMesh + chunk.meshCount; m++)
+            {
+                residentSlot[m] = static_cast<long long>(resident.size());
+                if (meshSlot[m] >= 0)
+                {
+                    resident.push_back(std::move(meshes[meshSlot[m]]));
+                    continue;
+                }
+                resident.push_back(cachedMesh(cachedPending->entries[m], pager->arena(c), pager->slice(m)));
+                Mesh& added = resident.back();
+                added.lod = added.fadingFrom = levelFor(added, modelView, scale, pixelsPerUnit, lodPixelError);
+            }
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        meshes.swap(resident);
+        meshSlot.swap(residentSlot);
+        // paged meshes are never previews and never batched
+        meshPreview.assign(meshes.size(), false);
+        meshBatch.clear();
+        batches.clear();
+        refreshBoxes();
+    }
 
-        unsigned int totalMeshes = scene->mNumMeshes;
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    // model bounds from the scene boxes, then lets the GL thread start pumping
+    void publishBounds()
+    {
+        for (const Bounds& box : sceneBounds)
+            bounds.extend(box);
+        sphere = bounds.sphere();
+        modelCenter = bounds.center();
+        modelWidth = bounds.size().x;
+        modelHeight = bounds.size().y;
+        meshSlot.assign(sceneBounds.size(), -1);
+        hasPreview = true;
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(const aiNode* node, const aiScene* scene, vector<const aiMesh*>& sceneMeshes)
     {
-        // process each mesh located at the current node
+        // collect each mesh located at the current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        // after we've collected all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, sceneMeshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // runs on a pool worker: must only read the scene and write into its own MeshData (and preview, if given).
+    // The unpacked arrays only live until the mesh is packed, they and all the other temporaries come from scratch.
+    MeshData processMesh(const aiMesh* mesh, const aiScene* scene, MeshOptimizationStats& optimization, std::pmr::memory_resource* scratch,
+                         MeshData* preview = nullptr)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Texture>& textures = data.textures;
+
+        // size the arrays once and write the vertices in place instead of growing them one push_back at a time
+        std::pmr::vector<Vertex> vertices(mesh->mNumVertices, scratch);
+        std::pmr::vector<unsigned int> indices(scratch);
+        const bool hasNormals = mesh->HasNormals();
+        const bool hasTexCoords = mesh->mTextureCoords[0] != nullptr;
+        const bool hasTangents = hasTexCoords && mesh->HasTangentsAndBitangents();
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            Vertex& vertex = vertices[i];
             // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            Min = min(Min, vector);
-            Max = max(Max, vector);
-            vertex.Position = vector;
+            const aiVector3D& position = mesh->mVertices[i];
+            vertex.Position = glm::vec3(position.x, position.y, position.z);
             // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
+            if (hasNormals)
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
             // texture coordinates
-            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            if (hasTexCoords) // does the mesh contain texture coordinates?
             {
-                glm::vec2 vec;
                 // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
                 // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            }
+            if (hasTangents)
+            {
                 // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
                 // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
             }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
         }
+        // bone influences, only skinned meshes get bone attributes at all
+        if (mesh->HasBones())
+            loadBoneWeights(mesh, vertices);
+        // aiProcess_GenBoundingBoxes already computed the box, only reduce over the positions if it didn't
+        if (!vertices.empty())
+        {
+            data.bounds.min = glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z);
+            data.bounds.max = glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z);
+        }
+        if (!data.bounds.valid() && !vertices.empty())
+            data.bounds = computeBounds(&vertices[0].Position, vertices.size(), sizeof(Vertex));
+
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace& face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
         }
         // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
@@ -167,94 +704,396 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
+
+        // weld, reorder for the vertex cache and overdraw, then lay the vertices out in fetch order
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            optimization = optimizeMesh(vertices, indices, data.bounds);
+
+        // simplified levels of detail, appended to the index buffer behind the full mesh
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            buildLods(vertices, indices, data.lods);
+        else
+            data.lods.push_back(MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0, 0, 0.0f });
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // pick the compact GPU layout for what this mesh actually uses
+        unsigned int vertexFlags = 0;
+        if (hasNormals)
+            vertexFlags |= hasTangents ? VERTEX_TANGENT_FRAME : VERTEX_NORMAL;
+        if (hasTexCoords)
+            vertexFlags |= chooseUvEncoding(vertices.data(), vertices.size());
+        if (mesh->HasBones())
+            vertexFlags |= VERTEX_SKINNED;
+        data.format = makeVertexFormat(vertexFlags);
+
+        // the coarsest level on its own, shown while the import is still running
+        if (preview != nullptr && data.lods.size() > 1)
+            buildPreview(vertices, indices, data, *preview);
+
+        // meshes a little over 65536 vertices are cut into ranges so they can still use 16 bit indices
+        splitIndexRanges(vertices, indices, data.ranges, data.lods);
+        data.indexType = packIndices(indices.data(), indices.size(), data.packedIndices);
+        packVertices(vertices.data(), vertices.size(), data.format, data.packedVertices);
+        data.vertexCount = vertices.size();
+        data.indexCount = indices.size();
+
+        // the packed arrays are all the upload and the cache need, the unpacked ones go with the scratch arena
+        if (keepsCpuGeometry())
+        {
+            data.vertices.assign(vertices.begin(), vertices.end());
+            data.indices.assign(indices.begin(), indices.end());
+        }
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    // copies the last level of data into a mesh of its own, with only the vertices that level uses
+    void buildPreview(const std::pmr::vector<Vertex>& vertices, const std::pmr::vector<unsigned int>& indices, const MeshData& data, MeshData& preview)
     {
-        vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        std::pmr::memory_resource* scratch = vertices.get_allocator().resource();
+        const MeshLod& coarsest = data.lods.back();
+        std::pmr::vector<unsigned int> remap(vertices.size(), ~0u, scratch);
+        std::pmr::vector<Vertex> previewVertices(scratch);
+        std::pmr::vector<unsigned int> previewIndices(scratch);
+        previewIndices.reserve(coarsest.indexCount);
+        for (uint32_t i = coarsest.firstIndex; i < coarsest.firstIndex + coarsest.indexCount; i++)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
+            unsigned int& local = remap[indices[i]];
+            if (local == ~0u)
             {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                local = static_cast<unsigned int>(previewVertices.size());
+                previewVertices.push_back(vertices[indices[i]]);
+            }
+            previewIndices.push_back(local);
+        }
+        preview.textures = data.textures;
+        preview.bounds = data.bounds;
+        preview.format = data.format;
+        preview.indexType = packIndices(previewIndices.data(), previewIndices.size(), preview.packedIndices);
+        packVertices(previewVertices.data(), previewVertices.size(), preview.format, preview.packedVertices);
+        preview.vertexCount = previewVertices.size();
+        preview.indexCount = previewIndices.size();
+    }
+
+    // keeps the MAX_BONE_INFLUENCE strongest bones per vertex
+    void loadBoneWeights(const aiMesh* mesh, std::pmr::vector<Vertex>& vertices)
+    {
+        for (unsigned int b = 0; b < mesh->mNumBones; b++)
+        {
+            const aiBone* bone = mesh->mBones[b];
+            for (unsigned int w = 0; w < bone->mNumWeights; w++)
+            {
+                const aiVertexWeight& weight = bone->mWeights[w];
+                if (weight.mVertexId >= vertices.size())
+                    continue;
+                Vertex& vertex = vertices[weight.mVertexId];
+                int weakest = 0;
+                for (int slot = 1; slot < MAX_BONE_INFLUENCE; slot++)
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    if (vertex.m_Weights[slot] < vertex.m_Weights[weakest])
+                        weakest = slot;
+                }
+                if (weight.mWeight > vertex.m_Weights[weakest])
+                {
+                    vertex.m_BoneIDs[weakest] = static_cast<int>(b);
+                    vertex.m_Weights[weakest] = weight.mWeight;
                 }
             }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        }
+    }
+
+    // what one upload needs from a pending mesh, a preview or a cache entry
+    struct UploadSource
+    {
+        VertexFormat format;
+        GLenum indexType;
+        const void* vertices;
+        size_t vertexCount;
+        const void* indices;
+        size_t indexCount;
+    };
+
+    UploadSource sourceOf(const Arrival& arrival) const
+    {
+        if (cachedPending)
+        {
+            const MeshCacheEntry& entry = cachedPending->entries[arrival.mesh];
+            return UploadSource{ makeVertexFormat(entry.vertexFlags), entry.indexType, cachedPending->vertices(entry), entry.vertexCount,
+                                 cachedPending->indices(entry), entry.indexCount };
+        }
+        const MeshData& data = arrival.preview ? previews[arrival.mesh] : pending[arrival.mesh];
+        return UploadSource{ data.format, data.indexType, data.packedVertices.data(), data.vertexCount, data.packedIndices.data(), data.indexCount };
+    }
+
+    size_t arrivalBytes(const Arrival& arrival) const
+    {
+        const UploadSource source = sourceOf(arrival);
+        return source.vertexCount * source.format.stride + source.indexCount * indexSize(source.indexType);
+    }
+
+    // GL thread only: loads the textures the workers asked for and writes the arrived meshes into their slices.
+    // A full mesh goes into the slice reserved for it, a preview into a new set of pools in previewArena and
+    // becomes a mesh of its own that the full mesh replaces later.
+    void uploadArrivals(const vector<Arrival>& taken)
+    {
+        if (!previewArena)
+            previewArena.reset(new GeometryArena());
+        // size the preview buffers first, then fill them mesh by mesh
+        vector<UploadSource> sources(taken.size());
+        vector<GeometryArena::Slice> slices(taken.size());
+        for (size_t i = 0; i < taken.size(); i++)
+        {
+            sources[i] = sourceOf(taken[i]);
+            if (taken[i].preview)
+                slices[i] = previewArena->reserve(sources[i].format, sources[i].indexType, sources[i].vertexCount, sources[i].indexCount);
+            else
+                slices[i] = meshSlices[taken[i].mesh];
+        }
+        // a no-op once the pools exist
+        arena.allocate();
+        previewArena->allocate();
+
+        meshes.reserve(meshSlot.size());
+        for (size_t i = 0; i < taken.size(); i++)
+        {
+            const Arrival& arrival = taken[i];
+            GeometryArena& owner = arrival.preview ? *previewArena : arena;
+            owner.write(slices[i], sources[i].vertices, sources[i].vertexCount, sources[i].indices, sources[i].indexCount);
+            if (cachedPending)
+                place(arrival.mesh, cachedMesh(cachedPending->entries[arrival.mesh], owner, slices[i]), arrival.preview);
+            else
+                place(arrival.mesh, convertedMesh(arrival.preview ? previews[arrival.mesh] : pending[arrival.mesh], owner, slices[i], !arrival.preview),
+                      arrival.preview);
+        }
+    }
+
+    // the first upload of a scene mesh adds it, the next one (the full mesh after its preview) takes its place
+    void place(size_t sceneMesh, Mesh mesh, bool preview)
+    {
+        if (meshSlot[sceneMesh] >= 0)
+        {
+            meshes[meshSlot[sceneMesh]] = std::move(mesh);
+            meshPreview[meshSlot[sceneMesh]] = preview;
+            return;
+        }
+        meshSlot[sceneMesh] = static_cast<long long>(meshes.size());
+        meshes.push_back(std::move(mesh));
+        meshPreview.push_back(preview);
+    }
+
+    // return a mesh object created from the extracted mesh data. With take the data is moved into the mesh,
+    // otherwise (the worker may still be reading it) it's copied.
+    Mesh convertedMesh(MeshData& data, const GeometryArena& owner, const GeometryArena::Slice& slice, bool take)
+    {
+        if (!take)
+        {
+            MeshData copy;
+            copy.textures = data.textures;
+            copy.ranges = data.ranges;
+            copy.lods = data.lods;
+            copy.bounds = data.bounds;
+            copy.indexCount = data.indexCount;
+            return convertedMesh(copy, owner, slice, true);
+        }
+        for (Texture& texture : data.textures)
+            texture.id = loadTexture(texture);
+        Mesh mesh(owner, slice, data.indexCount, std::move(data.ranges), std::move(data.lods), std::move(data.textures), data.bounds);
+        mesh.vertices = std::move(data.vertices);
+        mesh.indices = std::move(data.indices);
+        return mesh;
+    }
+
+    // same, but the description comes straight out of the mapped cache file
+    Mesh cachedMesh(const MeshCacheEntry& entry, const GeometryArena& owner, const GeometryArena::Slice& slice)
+    {
+        const CachedModel& cached = *cachedPending;
+        vector<Texture> textures(entry.textureCount);
+        for (uint32_t t = 0; t < entry.textureCount; t++)
+        {
+            const MeshCacheTexture& record = cached.textures[entry.firstTexture + t];
+            textures[t].type = cached.text(record.typeOffset, record.typeLength);
+            textures[t].path = cached.text(record.pathOffset, record.pathLength);
+            textures[t].id = loadTexture(textures[t]);
+        }
+        vector<IndexRange> ranges(cached.ranges + entry.firstRange, cached.ranges + entry.firstRange + entry.rangeCount);
+        vector<MeshLod> lods(cached.lods + entry.firstLod, cached.lods + entry.firstLod + entry.lodCount);
+        return Mesh(owner, slice, entry.indexCount, std::move(ranges), std::move(lods), std::move(textures), cachedBounds(entry));
+    }
+
+    static Bounds cachedBounds(const MeshCacheEntry& entry)
+    {
+        Bounds bounds;
+        bounds.min = glm::vec3(entry.aabbMin[0], entry.aabbMin[1], entry.aabbMin[2]);
+        bounds.max = glm::vec3(entry.aabbMax[0], entry.aabbMax[1], entry.aabbMax[2]);
+        return bounds;
+    }
+
+    // twelve edges per scene mesh box as GL_LINES, uploaded once when the first boxes are known
+    void uploadBoxes()
+    {
+        // corners are numbered by their max bits: 1 = x, 2 = y, 4 = z
+        static const int edges[24] = { 0, 1, 1, 3, 3, 2, 2, 0, 4, 5, 5, 7, 7, 6, 6, 4, 0, 4, 1, 5, 2, 6, 3, 7 };
+        vector<glm::vec3> lines;
+        lines.reserve(sceneBounds.size() * 24);
+        boxStart.assign(sceneBounds.size(), -1);
+        for (size_t i = 0; i < sceneBounds.size(); i++)
+        {
+            const Bounds& box = sceneBounds[i];
+            if (!box.valid())
+                continue;
+            boxStart[i] = static_cast<GLint>(lines.size());
+            for (int corner : edges)
+                lines.push_back(glm::vec3((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z));
+        }
+        if (lines.empty())
+            return;
+
+        boxVAO = GLVertexArray::create();
+        boxVBO = GLBuffer::create();
+        glBindVertexArray(boxVAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(glm::vec3), lines.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindVertexArray(0);
+        refreshBoxes();
+    }
+
+    // the boxes of scene meshes that have nothing uploaded yet, or of chunks that aren't paged in
+    void refreshBoxes()
+    {
+        boxFirst.clear();
+        boxCount.clear();
+        if (!boxVAO)
+            return;
+        for (size_t i = 0; i < boxStart.size(); i++)
+        {
+            const bool uploaded = pagedBoxes ? pager->onGpu(i) : meshSlot[i] >= 0;
+            if (boxStart[i] >= 0 && !uploaded)
+            {
+                boxFirst.push_back(boxStart[i]);
+                boxCount.push_back(24);
             }
         }
-        return textures;
     }
-};
 
+    void drawBoxes(Shader& blueShader)
+    {
+        blueShader.use();
+        glBindVertexArray(boxVAO.get());
+        glLineWidth(1.0f);
+        glMultiDrawArrays(GL_LINES, boxFirst.data(), boxCount.data(), static_cast<GLsizei>(boxFirst.size()));
+        glBindVertexArray(0);
+    }
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-    std::cout << filename << '\n';
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    void deleteBoxes()
+    {
+        boxVAO.reset();
+        boxVBO.reset();
+        boxStart.clear();
+        boxFirst.clear();
+        boxCount.clear();
+    }
+
+    // groups the meshes by pool and texture set, every group becomes one multi-draw. Previews aren't in arena's pools and stay out.
+    void buildBatches()
+    {
+        batches.clear();
+        meshBatch.resize(meshes.size());
+        map<pair<unsigned int, Material>, size_t> byMaterial;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            if (meshPreview[i])
+                continue;
+            auto key = make_pair(meshes[i].pool, meshes[i].material);
+            auto found = byMaterial.find(key);
+            if (found == byMaterial.end())
+            {
+                found = byMaterial.emplace(std::move(key), batches.size()).first;
+                batches.push_back(DrawBatch());
+                batches.back().pool = meshes[i].pool;
+                batches.back().material = i;
+            }
+            meshBatch[i] = found->second;
+        }
+        refreshBatches();
+    }
+
+    // refills the batches with the levels selected for this frame. The vectors keep their capacity, so no allocations once warmed up.
+    void refreshBatches()
+    {
+        for (DrawBatch& batch : batches)
+        {
+            batch.counts.clear();
+            batch.offsets.clear();
+            batch.baseVertices.clear();
+        }
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            if (!meshes[i].fading() && !meshPreview[i])
+                meshes[i].appendTo(batches[meshBatch[i]]);
+        }
+    }
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // same as Mesh::Draw, but every mesh of the batch goes out in one call
+    void drawBatch(const DrawBatch& batch, Shader& shader)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        meshes[batch.material].material.bind();
+        const GLenum indexType = arena.indexType(batch.pool);
+        const GLsizei drawCount = static_cast<GLsizei>(batch.counts.size());
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        shader.use();
+        glBindVertexArray(arena.VAO(batch.pool));
+        shader.setInt(UNIFORM_TANGENT_FRAME, arena.format(batch.pool).has(VERTEX_TANGENT_FRAME) ? 1 : 0);
+        shader.setFloat(UNIFORM_LOD_FADE, 0.0f);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), indexType, batch.offsets.data(), drawCount, batch.baseVertices.data());
+        glActiveTexture(GL_TEXTURE0);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Reset states
+        glBindVertexArray(0);
+    }
 
-        stbi_image_free(data);
+    // collects all material textures of a given type. Only the type and path are filled in here,
+    // the texture itself is loaded on the main thread by loadTexture.
+    void loadMaterialTextures(const aiMaterial* mat, aiTextureType type, const char* typeName, vector<Texture>& textures)
+    {
+        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(std::move(texture));
+        }
     }
-    else
+
+    // returns the GL texture for a material texture, acquiring it from the shared cache the first time this model uses it.
+    unsigned int loadTexture(const Texture& wanted)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        auto found = textures_loaded.find(wanted.path);
+        if (found != textures_loaded.end())
+            return found->second;
+        unsigned int id = TextureFromFile(wanted.path.c_str(), this->directory);
+        textures_loaded.emplace(wanted.path, id);
+        return id;
     }
+};
 
-    return textureID;
+
+// returns right away with a placeholder texture, the image itself is decoded and uploaded by the TextureLoader.
+// the texture comes from the shared TextureCache, the caller owns one reference and must release it.
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
+    std::cout << filename << '\n';
+    return TextureCache::instance().acquire(filename);
 }
 #endif
\ No newline at end of file
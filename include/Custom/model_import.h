@@ -0,0 +1,123 @@
+#ifndef MODEL_IMPORT_H
+#define MODEL_IMPORT_H
+
+#include <Custom/model.h>
+
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Runs Model::prepare on a background thread so the render loop (and the gesture socket) keep going
+// while a file is read and converted. Meanwhile the render thread shows partial() and pump()s it a few
+// milliseconds per frame. Once the worker is done and everything is uploaded, ready() says so and take()
+// hands the model over, so the caller can swap it in between two frames without an upload stall.
+class ModelImport
+{
+public:
+    ModelImport() = default;
+    ModelImport(const ModelImport&) = delete;
+    ModelImport& operator=(const ModelImport&) = delete;
+
+    ~ModelImport()
+    {
+        cancel();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // starts importing path. Only one import runs at a time, returns false while another one is busy.
+    // cpuGeometryUses are the CpuGeometryUse bits of whoever needs the meshes' CPU copies afterwards.
+    bool start(const std::string& path, unsigned int cpuGeometryUses = 0)
+    {
+        if (busy())
+            return false;
+        if (worker.joinable())
+            worker.join();
+
+        fileName = path.substr(path.find_last_of('/') + 1);
+        progress.reset(new ImportProgress());
+        model.reset(new Model());
+        model->cpuGeometryUses = cpuGeometryUses;
+        succeeded = false;
+        finished = false;
+        active = true;
+
+        worker = std::thread([this, path]() {
+            // an exception thrown by a conversion on the pool comes back here, it fails the import instead of the program
+            try
+            {
+                succeeded = model->prepare(path, progress.get());
+            }
+            catch (const std::exception& e)
+            {
+                std::cout << "ERROR::MODEL_IMPORT:: " << fileName << ": " << e.what() << std::endl;
+                succeeded = false;
+            }
+            finished = true;
+        });
+        return true;
+    }
+
+    // an import is running or waiting to be collected by take()
+    bool busy() const { return active; }
+
+    // GL thread only. The background part is done and pump() uploaded everything, take() won't block.
+    // A failed or cancelled import is ready right away.
+    bool ready() const
+    {
+        return active && finished && (!succeeded || progress->cancelRequested || model->uploaded());
+    }
+
+    float fraction() const { return progress ? progress->fraction.load() : 0.0f; }
+    bool cancelling() const { return progress && progress->cancelRequested; }
+    const std::string& name() const { return fileName; }
+
+    // the model being imported once it has something to show, nullptr before that and after a cancel.
+    // GL thread only: it may be pumped and drawn, but it still belongs to the import.
+    Model* partial() const
+    {
+        if (!active || !model || progress->cancelRequested || !model->previewReady())
+            return nullptr;
+        return model.get();
+    }
+
+    void cancel()
+    {
+        if (progress)
+            progress->cancelRequested = true;
+    }
+
+    // GL thread only. Hands the imported model over, nullptr if it failed or was cancelled. Meant to be called once
+    // ready(), before that it waits for the worker and uploads the rest in one go.
+    Model* take()
+    {
+        if (!active)
+            return nullptr;
+        if (worker.joinable())
+            worker.join();
+        active = false;
+
+        if (!succeeded || progress->cancelRequested)
+        {
+            model.reset();
+            return nullptr;
+        }
+        model->finish();
+        progress->fraction = 1.0f;
+        return model.release();
+    }
+
+private:
+    std::thread worker;
+    std::unique_ptr<Model> model;
+    std::unique_ptr<ImportProgress> progress;
+    std::string fileName;
+    std::atomic<bool> finished{ false };
+    std::atomic<bool> succeeded{ false };
+    bool active = false;
+};
+
+#endif // !MODEL_IMPORT_H
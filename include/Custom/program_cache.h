@@ -0,0 +1,251 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked shader programs.
+// A program is saved with glGetProgramBinary after its first successful link and loaded with glProgramBinary
+// on the next launch, which skips compiling and linking altogether. Files are keyed by a hash of the shader
+// sources together with the driver's vendor, renderer and version strings, so editing a shader or updating the
+// driver just misses the cache; a binary the driver still rejects is deleted and the program built from source.
+//
+// Our glad only covers GL 3.3 core, so the program binary functions (GL 4.1 / ARB_get_program_binary) and
+// KHR_parallel_shader_compile are loaded by hand in init(). Without them everything is compiled from source as before.
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#define PROGRAM_CACHE_VERSION 1
+
+const char PROGRAM_CACHE_DIRECTORY[] = "GripXelCache/programs";
+
+struct ProgramCacheHeader
+{
+    char     magic[4];      // "GXPB"
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;        // binary format the driver reported
+    uint32_t length;        // bytes of binary following the header
+};
+
+class ProgramCache
+{
+public:
+    static ProgramCache& instance()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // GL thread only, once after glad is loaded. load is the same loader glad was given.
+    void init(GLADloadproc load)
+    {
+        const char* vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+        const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        driver = std::string(vendor ? vendor : "") + '\n' + (renderer ? renderer : "") + '\n' + (version ? version : "");
+
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 1) || hasExtension("GL_ARB_get_program_binary"))
+        {
+            getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+            programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+            programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+        }
+        // some drivers expose the functions but no format to save in
+        GLint formats = 0;
+        if (getProgramBinary != nullptr && programBinary != nullptr)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binaries = formats > 0;
+
+        // let the driver compile on as many threads as it likes, programs then build while we issue the next ones
+        MaxShaderCompilerThreadsProc maxThreads = nullptr;
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+        if (maxThreads != nullptr)
+        {
+            maxThreads(0xFFFFFFFFu);
+            parallel = true;
+        }
+    }
+
+    bool binariesSupported() const { return binaries; }
+    bool parallelCompile() const { return parallel; }
+
+    // key of a program built from sources on this driver
+    uint64_t key(const std::string& sources) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = hashBytes(hash, sources.data(), sources.size());
+        hash = hashBytes(hash, driver.data(), driver.size());
+        const uint32_t version = PROGRAM_CACHE_VERSION;
+        return hashBytes(hash, &version, sizeof(version));
+    }
+
+    // GL thread only. Fills program from the cached binary, false if there's none or the driver rejected it.
+    bool load(GLuint program, uint64_t key)
+    {
+        if (!binaries)
+            return false;
+        const std::filesystem::path path = pathFor(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            misses++;
+            return false;
+        }
+        ProgramCacheHeader header;
+        std::vector<char> binary;
+        bool valid = file.read(reinterpret_cast<char*>(&header), sizeof(header)) && std::memcmp(header.magic, "GXPB", 4) == 0
+                  && header.version == PROGRAM_CACHE_VERSION && header.key == key;
+        if (valid)
+        {
+            binary.resize(header.length);
+            valid = header.length > 0 && file.read(binary.data(), header.length);
+        }
+        file.close();
+
+        GLint linked = 0;
+        if (valid)
+        {
+            programBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+        if (!linked)
+        {
+            // stale or broken, it gets rewritten once the program is built from source
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // GL thread only, before linking a program whose binary should be saved afterwards
+    void prepare(GLuint program)
+    {
+        if (binaries && programParameteri != nullptr)
+            programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // GL thread only. Saves a successfully linked program.
+    void store(GLuint program, uint64_t key)
+    {
+        if (!binaries)
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLenum format = 0;
+        GLsizei written = 0;
+        getProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return;
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::u8path(PROGRAM_CACHE_DIRECTORY), error);
+        ProgramCacheHeader header;
+        std::memcpy(header.magic, "GXPB", 4);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.format = format;
+        header.length = static_cast<uint32_t>(written);
+        std::ofstream file(pathFor(key), std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !file.write(binary.data(), written))
+            std::cout << "ERROR::PROGRAM_CACHE:: could not write " << pathFor(key).u8string() << std::endl;
+    }
+
+    // GL thread only. false while a parallel compile of program is still running, so the caller can do other work.
+    bool ready(GLuint program) const
+    {
+        if (!parallel)
+            return true;
+        GLint done = GL_TRUE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // programs loaded from the cache and programs that had to be built from source this run
+    unsigned int cacheHits() const { return hits; }
+    unsigned int cacheMisses() const { return misses; }
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    bool binaries = false;
+    bool parallel = false;
+    std::string driver;
+    unsigned int hits = 0, misses = 0;
+
+    ProgramCache() = default;
+
+    static bool hasExtension(const char* name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (extension != nullptr && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // FNV-1a
+    static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static std::filesystem::path pathFor(uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.gxpb", static_cast<unsigned long long>(key));
+        return std::filesystem::u8path(PROGRAM_CACHE_DIRECTORY) / name;
+    }
+};
+
+#endif // !PROGRAM_CACHE_H
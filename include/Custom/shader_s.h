@@ -2,27 +2,95 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <Custom/gl_handle.h>
+#include <Custom/material.h>
+#include <Custom/program_cache.h>
+#include <array>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Uniforms the renderer sets every frame. Their locations are looked up once after link and kept in a flat
+// table, so setting one is an array read instead of a string lookup in the driver. A program that doesn't
+// use one gets location -1, which glUniform* ignores.
+enum ShaderUniform
+{
+	UNIFORM_MODEL,
+	UNIFORM_TANGENT_FRAME,
+	UNIFORM_LOD_FADE,
+	UNIFORM_WIREFRAME,
+	UNIFORM_COUNT
+};
+
+inline const char* shaderUniformName(ShaderUniform uniform) {
+	static const char* names[UNIFORM_COUNT] = { "model", "tangentFrame", "lodFade", "wireframe" };
+	return names[uniform];
+}
+
+// Camera matrices live in one std140 uniform block shared by every program:
+//   layout (std140) uniform Camera { mat4 projection; mat4 view; };
+// Every program's block is pointed at this binding point after link, the buffer is filled and bound once per frame.
+const GLuint CAMERA_UNIFORM_BINDING = 0;
+
+struct CameraUniforms
+{
+	glm::mat4 projection;	// std140: a mat4 is four vec4 columns, so the C++ layout matches as is
+	glm::mat4 view;
+};
+
+class CameraUniformBuffer
+{
+public:
+	// GL thread only, once per frame before drawing
+	void update(const glm::mat4& projection, const glm::mat4& view) {
+		if (!buffer) {
+			buffer = GLBuffer::create();
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer.get());
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniforms), NULL, GL_DYNAMIC_DRAW);
+		}
+		const CameraUniforms uniforms = { projection, view };
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer.get());
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUniforms), &uniforms);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UNIFORM_BINDING, buffer.get());
+	}
+
+	// GL thread only, before the context goes away
+	void release() {
+		buffer.reset();
+	}
+
+private:
+	GLBuffer buffer;
+};
+
 class Shader
 {
 public:
 
-	unsigned int ID;
+	unsigned int ID = 0;	// name of program, kept for glGetUniformLocation and friends
+
+	// empty shader, owns no program
+	Shader() {}
 
-	Shader(const char* vertexPath, const char* fragmentPath) {
+	// the geometry shader is optional. The program comes from the ProgramCache when it has it, otherwise it's
+	// compiled from source. A deferred shader only starts the compile: issue every shader first and finish() them
+	// afterwards, so a driver with parallel compile builds them all at once.
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, bool deferred = false) {
 
-		std::string vertexCode, fragmentCode;
-		std::ifstream vShaderFile, fShaderFile;
+		std::string vertexCode, fragmentCode, geometryCode;
+		std::ifstream vShaderFile, fShaderFile, gShaderFile;
 
 		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
 		try {
 			vShaderFile.open(vertexPath);
@@ -38,65 +106,224 @@ public:
 
 			vertexCode = vertexShaderStream.str();
 			fragmentCode = fragmentShaderStream.str();
+
+			if (geometryPath != nullptr) {
+				gShaderFile.open(geometryPath);
+				std::stringstream geometryShaderStream;
+				geometryShaderStream << gShaderFile.rdbuf();
+				gShaderFile.close();
+				geometryCode = geometryShaderStream.str();
+			}
 		}
 		catch (std::ifstream::failure e) {
 			std::cout << "ERROR : FAILED to read the Shader files." << '\n';
 		}
+		program = GLProgram::create();
+		ID = program.get();
+		cacheKey = ProgramCache::instance().key(vertexCode + '\0' + fragmentCode + '\0' + geometryCode);
+		if (ProgramCache::instance().load(ID, cacheKey)) {
+			resolveUniforms();
+			return;
+		}
+
+		// no status queries until finish(), any of them would wait for the compile
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
 
-		unsigned int vertex, fragment;
 		vertex = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vertex, 1, &vShaderCode, NULL);
 		glCompileShader(vertex);
-		compilationCheck(vertex, "VERTEX");
 
 		fragment = glCreateShader(GL_FRAGMENT_SHADER);
 		glShaderSource(fragment, 1, &fShaderCode, NULL);
 		glCompileShader(fragment);
-		compilationCheck(fragment, "FRAGMENT");
 
-		ID = glCreateProgram();
+		if (geometryPath != nullptr) {
+			const char* gShaderCode = geometryCode.c_str();
+			geometry = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(geometry, 1, &gShaderCode, NULL);
+			glCompileShader(geometry);
+		}
+
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
+		if (geometry != 0)
+			glAttachShader(ID, geometry);
+		ProgramCache::instance().prepare(ID);
 		glLinkProgram(ID);
-		compilationCheck(ID, "PROGRAM");
+		building = true;
+
+		if (!deferred)
+			finish();
+	}
 
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
+	~Shader() {
+		deleteStages();
+	}
+
+	// waits for a program built from source, reports errors and saves it to the ProgramCache. Has to be called
+	// before the first use() of a deferred shader, does nothing otherwise.
+	void finish() {
+		if (!building)
+			return;
+		building = false;
+		compilationCheck(vertex, "VERTEX");
+		compilationCheck(fragment, "FRAGMENT");
+		if (geometry != 0)
+			compilationCheck(geometry, "GEOMETRY");
+		if (compilationCheck(ID, "PROGRAM"))
+			ProgramCache::instance().store(ID, cacheKey);
+		resolveUniforms();
+		deleteStages();
+	}
+
+	// false while a deferred shader is still compiling in the background, finish() would wait for it
+	bool ready() const {
+		return !building || ProgramCache::instance().ready(ID);
+	}
+
+	// the program is deleted with the shader, so it's move-only like the handle it holds
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+	Shader(Shader&& other) noexcept : ID(other.ID), program(std::move(other.program)), locations(other.locations), byName(std::move(other.byName)),
+		vertex(other.vertex), fragment(other.fragment), geometry(other.geometry), cacheKey(other.cacheKey), building(other.building) {
+		other.ID = 0;
+		other.vertex = other.fragment = other.geometry = 0;
+		other.building = false;
+	}
+	Shader& operator=(Shader&& other) noexcept {
+		deleteStages();
+		program = std::move(other.program);
+		ID = program.get();
+		locations = other.locations;
+		byName = std::move(other.byName);
+		vertex = other.vertex;
+		fragment = other.fragment;
+		geometry = other.geometry;
+		cacheKey = other.cacheKey;
+		building = other.building;
+		other.ID = 0;
+		other.vertex = other.fragment = other.geometry = 0;
+		other.building = false;
+		return *this;
 	}
 
 	void use() {
 		glUseProgram(ID);
 	}
 
+	// location of a uniform from the table built at link time, -1 if the program doesn't use it
+	GLint location(ShaderUniform uniform) const {
+		return locations[uniform];
+	}
+	GLint location(const std::string& name) const {
+		auto found = byName.find(name);
+		return found != byName.end() ? found->second : -1;
+	}
+
+	// the program has to be in use. The handle overloads are for the per frame path, the name ones
+	// still avoid the driver lookup but hash the name.
+	void setInt(ShaderUniform uniform, int value) {
+		glUniform1i(locations[uniform], value);
+	}
+	void setFloat(ShaderUniform uniform, float value) {
+		glUniform1f(locations[uniform], value);
+	}
+	void setMat4(ShaderUniform uniform, const glm::mat4& value) {
+		glUniformMatrix4fv(locations[uniform], 1, GL_FALSE, &value[0][0]);
+	}
+
 	void setBool(const std::string& name, bool value) {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(location(name), (int)value);
 	}
 	void setInt(const std::string& name, int value) {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(location(name), value);
 	}
 	void setFloat(const std::string& name, float value) {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(location(name), value);
 	}
 	void setFloat4(const std::string& name, float value1,float value2, float value3) {
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), value1,value2,value3,1.0f);
+		glUniform4f(location(name), value1,value2,value3,1.0f);
 	}
 	
-	void setMat4(const std::string& name, glm::mat4 value) {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1,GL_FALSE,&value[0][0]);
+	void setMat4(const std::string& name, const glm::mat4& value) {
+		glUniformMatrix4fv(location(name), 1,GL_FALSE,&value[0][0]);
 	}
 
 	void setVec3(const std::string& name, const glm::vec3& value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(location(name), 1, &value[0]);
 	}
 	void setVec2(const std::string& name, const glm::vec2& value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(location(name), 1, &value[0]);
 	}
 
 private:
 
-	void compilationCheck(unsigned int shader, std::string type) {
+	GLProgram program;
+	std::array<GLint, UNIFORM_COUNT> locations{};
+	std::unordered_map<std::string, GLint> byName;	// every active uniform outside a block, arrays under their base name
+
+	// stages of a program still being built from source, deleted by finish()
+	unsigned int vertex = 0, fragment = 0, geometry = 0;
+	uint64_t cacheKey = 0;
+	bool building = false;
+
+	void deleteStages() {
+		for (unsigned int* stage : { &vertex, &fragment, &geometry }) {
+			if (*stage != 0)
+				glDeleteShader(*stage);
+			*stage = 0;
+		}
+	}
+
+	// walks the active uniforms once after link and fills the location tables, ties the samplers to their
+	// texture units and points the Camera block at its binding
+	void resolveUniforms() {
+		locations.fill(-1);
+		byName.clear();
+
+		GLint count = 0, longest = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longest);
+		std::string name(longest > 0 ? longest : 1, '\0');
+		std::vector<std::pair<GLint, int>> samplers;	// location, unit
+		for (GLint i = 0; i < count; i++) {
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &size, &type, &name[0]);
+			std::string uniform(name.data(), length);
+			// arrays are reported as name[0]
+			const size_t bracket = uniform.find('[');
+			if (bracket != std::string::npos)
+				uniform.resize(bracket);
+			// members of uniform blocks have no location
+			const GLint where = glGetUniformLocation(ID, uniform.c_str());
+			if (where < 0)
+				continue;
+			byName[uniform] = where;
+			if (type == GL_SAMPLER_2D && samplerUnit(uniform) >= 0)
+				samplers.emplace_back(where, samplerUnit(uniform));
+		}
+		for (int uniform = 0; uniform < UNIFORM_COUNT; uniform++)
+			locations[uniform] = location(shaderUniformName(static_cast<ShaderUniform>(uniform)));
+
+		// samplers keep their unit for good, so drawing only binds textures (see Material)
+		if (!samplers.empty()) {
+			GLint previous = 0;
+			glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+			glUseProgram(ID);
+			for (const auto& sampler : samplers)
+				glUniform1i(sampler.first, sampler.second);
+			glUseProgram(static_cast<GLuint>(previous));
+		}
+
+		const GLuint camera = glGetUniformBlockIndex(ID, "Camera");
+		if (camera != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, camera, CAMERA_UNIFORM_BINDING);
+	}
+
+	bool compilationCheck(unsigned int shader, std::string type) {
 		int success;
 		char infolog[1024];
 
@@ -115,6 +342,7 @@ private:
 				std::cout << "ERROR : Compilation of "<< type<< " Shader Failed. " << infolog << '\n';
 			}
 		}
+		return success != 0;
 	}
 };
 
@@ -0,0 +1,65 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+// The producer only writes head and the consumer only writes tail, each publishes with a release store that the
+// other side reads with acquire, so a slot is never read before it's written or overwritten before it's read.
+// Both sides keep a copy of the other's index and only reload it when the ring looks full (or empty), and the
+// indices sit on cache lines of their own, so a push or pop usually touches no line the other thread writes.
+
+const size_t SPSC_CACHE_LINE = 64;
+
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // producer thread only. false if the ring is full, the item isn't queued then.
+    bool push(const T& item)
+    {
+        const size_t position = head.load(std::memory_order_relaxed);
+        if (position - tailSeen == Capacity)
+        {
+            tailSeen = tail.load(std::memory_order_acquire);
+            if (position - tailSeen == Capacity)
+                return false;
+        }
+        slots[position & (Capacity - 1)] = item;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only. false if the ring is empty.
+    bool pop(T& item)
+    {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        if (position == headSeen)
+        {
+            headSeen = head.load(std::memory_order_acquire);
+            if (position == headSeen)
+                return false;
+        }
+        item = slots[position & (Capacity - 1)];
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // written by the producer
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> head{ 0 };
+    size_t tailSeen = 0;
+    // written by the consumer
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail{ 0 };
+    size_t headSeen = 0;
+    alignas(SPSC_CACHE_LINE) T slots[Capacity];
+};
+
+#endif // !SPSC_RING_H
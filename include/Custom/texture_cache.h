@@ -0,0 +1,151 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <Custom/gl_handle.h>
+#include <Custom/texture_loader.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process wide texture cache.
+// Textures are looked up by a 64 bit hash of their resolved path (and optionally of the file contents),
+// so every import and every Model shares one GL texture per image. Each Model acquires a texture once
+// and releases it when it is destroyed; the GL texture is deleted as soon as the last user lets go.
+class TextureCache
+{
+public:
+    static TextureCache& instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // also match identical images stored under different paths. Costs a full read of every new file.
+    bool hashContents = false;
+
+    // GL thread only. Returns the texture for resolvedPath and takes a reference on it.
+    unsigned int acquire(const std::string& resolvedPath)
+    {
+        const std::string key = normalize(resolvedPath);
+        const uint64_t pathHash = hash(key.data(), key.size());
+
+        auto found = byPath.find(pathHash);
+        if (found != byPath.end() && found->second.path == key)
+            return addRef(found->second.id);
+
+        uint64_t contentHash = 0;
+        if (hashContents && hashFile(resolvedPath, contentHash))
+        {
+            auto same = byContent.find(contentHash);
+            if (same != byContent.end())
+            {
+                // same pixels under another name: alias the path to the texture we already have
+                byPath[pathHash] = PathEntry{ key, same->second };
+                entries[same->second].pathHashes.push_back(pathHash);
+                return addRef(same->second);
+            }
+        }
+
+        GLTexture texture = TextureLoader::instance().request(resolvedPath);
+        const unsigned int id = texture.get();
+        Entry& entry = entries[id];
+        entry.texture = std::move(texture);
+        entry.contentHash = contentHash;
+        entry.hasContentHash = hashContents && contentHash != 0;
+        if (found == byPath.end())
+        {
+            byPath[pathHash] = PathEntry{ key, id };
+            entry.pathHashes.push_back(pathHash);
+        }
+        if (entry.hasContentHash)
+            byContent[contentHash] = id;
+        return addRef(id);
+    }
+
+    // GL thread only. Drops one reference and deletes the GL texture once nobody uses it anymore.
+    void release(unsigned int id)
+    {
+        auto found = entries.find(id);
+        if (found == entries.end() || --found->second.refs > 0)
+            return;
+
+        // forget every path that was aliased to this texture
+        for (uint64_t pathHash : found->second.pathHashes)
+            byPath.erase(pathHash);
+        if (found->second.hasContentHash)
+            byContent.erase(found->second.contentHash);
+
+        // erasing the entry deletes the texture
+        TextureLoader::instance().cancel(id);
+        entries.erase(found);
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry
+    {
+        GLTexture texture;
+        unsigned int refs = 0;
+        std::vector<uint64_t> pathHashes;
+        uint64_t contentHash = 0;
+        bool hasContentHash = false;
+    };
+    struct PathEntry
+    {
+        std::string path;   // kept to rule out hash collisions
+        unsigned int id;
+    };
+
+    std::unordered_map<unsigned int, Entry> entries;   // by GL texture name
+    std::unordered_map<uint64_t, PathEntry> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+
+    unsigned int addRef(unsigned int id)
+    {
+        entries[id].refs++;
+        return id;
+    }
+
+    // Windows paths: same file regardless of slash direction or case
+    static std::string normalize(std::string path)
+    {
+        std::replace(path.begin(), path.end(), '\\', '/');
+        std::transform(path.begin(), path.end(), path.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return path;
+    }
+
+    // FNV-1a
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t value = seed;
+        for (size_t i = 0; i < size; i++)
+        {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+        return value;
+    }
+
+    static bool hashFile(const std::string& path, uint64_t& value)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        value = 14695981039346656037ull;
+        char buffer[64 * 1024];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+            value = hash(buffer, static_cast<size_t>(file.gcount()), value);
+        return true;
+    }
+};
+
+#endif // !TEXTURE_CACHE_H
@@ -0,0 +1,284 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <Custom/gl_handle.h>
+#include <Custom/thread_pool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Asynchronous texture loading.
+// request() hands back a GL texture right away, filled with a 1x1 placeholder so meshes can draw
+// immediately. The file is decoded by stbi_load on the thread pool and the finished image is queued
+// for the GL thread. pump() maps a pixel buffer object from a small ring for it and a pool task copies
+// the pixels in; a later pump() issues glTexImage2D from the buffer into the same texture name. The copy
+// never runs on the GL thread, and the transfer out of the buffer doesn't wait for it.
+// Import time is then bounded by the slowest decode instead of the sum of all of them.
+
+// stage at most this much image data per frame, a 2K RGBA texture. One image always goes, however big.
+const size_t TEXTURE_UPLOAD_BUDGET_BYTES = 16 * 1024 * 1024;
+// pixel buffers in the ring, at most this many images are between decode and glTexImage2D at a time
+const size_t TEXTURE_UPLOAD_SLOTS = 4;
+
+class TextureLoader
+{
+public:
+    static TextureLoader& instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    TextureLoader() : finished(std::make_shared<FinishedQueue>())
+    {
+        for (std::shared_ptr<UploadSlot>& slot : slots)
+            slot = std::make_shared<UploadSlot>();
+    }
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // GL thread only. Creates the texture with placeholder contents and starts decoding filename in the background.
+    // The caller owns the texture; call cancel() before letting go of it.
+    GLTexture request(const std::string& filename)
+    {
+        GLTexture texture = GLTexture::create();
+        const unsigned int textureID = texture.get();
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        inFlight++;
+        const uint64_t ticket = ++nextTicket;
+        live[textureID] = ticket;
+        // the task only holds on to the queue, so it stays safe even if the loader is gone before it finishes
+        std::shared_ptr<FinishedQueue> queue = finished;
+        ThreadPool::instance().submit([queue, filename, textureID, ticket]() {
+            DecodedImage image;
+            image.textureID = textureID;
+            image.ticket = ticket;
+            image.filename = filename;
+            image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+
+            std::lock_guard<std::mutex> lock(queue->lock);
+            queue->images.push_back(image);
+        });
+        return texture;
+    }
+
+    // GL thread only, once per frame. Moves the images staged by earlier frames whose copy is done into their
+    // textures, then stages decoded images into free pixel buffers until the per-frame budget is used up.
+    void pump()
+    {
+        for (const std::shared_ptr<UploadSlot>& slot : slots)
+        {
+            if (slot->busy && slot->filled.load(std::memory_order_acquire))
+                upload(*slot);
+        }
+
+        size_t stagedBytes = 0;
+        while (stagedBytes < TEXTURE_UPLOAD_BUDGET_BYTES)
+        {
+            std::shared_ptr<UploadSlot> slot = freeSlot();
+            if (!slot)
+                break;
+            DecodedImage image;
+            {
+                std::lock_guard<std::mutex> lock(finished->lock);
+                if (finished->images.empty())
+                    break;
+                image = finished->images.front();
+                finished->images.pop_front();
+            }
+            stagedBytes += stage(image, slot);
+        }
+    }
+
+    // GL thread only. Call before deleting a texture that came from request(): a decode still in flight
+    // is thrown away instead of being uploaded into a name GL may already have handed out again.
+    void cancel(unsigned int textureID)
+    {
+        live.erase(textureID);
+    }
+
+    // number of textures still waiting to be decoded or uploaded
+    unsigned int pending() const { return inFlight; }
+
+    // GL thread only, before the context goes away. The loader is a static, it would outlive the context otherwise.
+    void shutdown()
+    {
+        live.clear();
+        for (const std::shared_ptr<UploadSlot>& slot : slots)
+        {
+            if (slot->busy)
+            {
+                // a copy may still be writing into the mapping, the buffer can only go once it's done
+                while (!slot->filled.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer.get());
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                slot->busy = false;
+            }
+            slot->buffer.reset();
+        }
+    }
+
+private:
+    struct DecodedImage
+    {
+        unsigned int textureID = 0;
+        uint64_t ticket = 0;
+        std::string filename;
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0, components = 0;
+    };
+
+    struct FinishedQueue
+    {
+        std::mutex lock;
+        std::deque<DecodedImage> images;
+    };
+
+    // one pixel buffer of the ring. busy from the map in stage() to the glTexImage2D in upload(),
+    // filled once the pool task copied the pixels into the mapping and freed them.
+    struct UploadSlot
+    {
+        GLBuffer buffer;
+        DecodedImage image;
+        GLenum format = GL_RGBA;
+        bool busy = false;
+        std::atomic<bool> filled{ false };
+    };
+
+    std::shared_ptr<FinishedQueue> finished;
+    std::unordered_map<unsigned int, uint64_t> live;  // texture name -> ticket of the request that owns it
+    uint64_t nextTicket = 0;
+    unsigned int inFlight = 0;
+    // the copy tasks hold on to their slot like the decode tasks to the queue
+    std::shared_ptr<UploadSlot> slots[TEXTURE_UPLOAD_SLOTS];
+
+    std::shared_ptr<UploadSlot> freeSlot() const
+    {
+        for (const std::shared_ptr<UploadSlot>& slot : slots)
+        {
+            if (!slot->busy)
+                return slot;
+        }
+        return nullptr;
+    }
+
+    // the request behind image still wants it
+    bool wanted(const DecodedImage& image) const
+    {
+        auto owner = live.find(image.textureID);
+        return owner != live.end() && owner->second == image.ticket;
+    }
+
+    // maps a pixel buffer for a decoded image and has a pool task copy the pixels in. Returns the bytes staged.
+    size_t stage(DecodedImage& image, const std::shared_ptr<UploadSlot>& slot)
+    {
+        if (!wanted(image))
+        {
+            // cancelled while it was decoding
+            stbi_image_free(image.pixels);
+            inFlight--;
+            return 0;
+        }
+        if (!image.pixels)
+        {
+            std::cout << "Texture failed to load at path: " << image.filename << std::endl;
+            live.erase(image.textureID);
+            inFlight--;
+            return 0;
+        }
+
+        GLenum format = GL_RGBA;
+        if (image.components == 1)
+            format = GL_RED;
+        else if (image.components == 2)
+            format = GL_RG;
+        else if (image.components == 3)
+            format = GL_RGB;
+        const size_t size = static_cast<size_t>(image.width) * image.height * image.components;
+
+        // orphan the buffer so mapping it never waits for the GPU to finish reading its last image
+        if (!slot->buffer)
+            slot->buffer = GLBuffer::create();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer.get());
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!mapped)
+        {
+            // mapping failed, fall back to a plain client memory upload right away
+            live.erase(image.textureID);
+            inFlight--;
+            texImage(image, format, image.pixels);
+            stbi_image_free(image.pixels);
+            return size;
+        }
+
+        slot->image = image;
+        slot->format = format;
+        slot->busy = true;
+        slot->filled.store(false, std::memory_order_relaxed);
+        std::shared_ptr<UploadSlot> held = slot;
+        ThreadPool::instance().submit([held, mapped, size]() {
+            std::memcpy(mapped, held->image.pixels, size);
+            stbi_image_free(held->image.pixels);
+            held->image.pixels = nullptr;
+            held->filled.store(true, std::memory_order_release);
+        });
+        return size;
+    }
+
+    // a staged image is in its buffer, hands the buffer back to GL and sources the texture from it
+    void upload(UploadSlot& slot)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer.get());
+        const bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        // a cancel while it was staged may have let the name go to a newer request, that one's entry stays
+        if (wanted(slot.image))
+        {
+            live.erase(slot.image.textureID);
+            if (intact)
+                texImage(slot.image, slot.format, 0); // offset 0 into the bound buffer
+            else
+                std::cout << "ERROR::TEXTURE_LOADER:: pixel buffer lost while mapped, keeping the placeholder for " << slot.image.filename << std::endl;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.busy = false;
+        inFlight--;
+    }
+
+    // source is client memory, or an offset into the bound pixel unpack buffer
+    static void texImage(const DecodedImage& image, GLenum format, const void* source)
+    {
+        // stb rows are tightly packed, 1 and 3 channel images are not 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, image.textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, source);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+};
+
+#endif // !TEXTURE_LOADER_H
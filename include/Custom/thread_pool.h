@@ -0,0 +1,208 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool used by the import path.
+// Every worker owns a deque: it pops its own work from the back (cache friendly, LIFO)
+// and steals from the front of the other deques when it runs dry, so a few huge meshes
+// don't leave the rest of the cores idle while one worker grinds through them.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+        {
+            unsigned int hw = std::thread::hardware_concurrency();
+            // leave one core for the render thread, it keeps drawing while we convert
+            threadCount = hw > 1 ? hw - 1 : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; i++)
+            queues.emplace_back(new Queue());
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // process wide pool, created on first use
+    static ThreadPool& instance()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // index of the worker the caller runs on, -1 on any thread that isn't one of ours
+    static int workerIndex() { return currentWorker(); }
+
+    // queues a task. from a worker it lands on that worker's own deque, from any other
+    // thread the deques are filled round robin.
+    void submit(std::function<void()> task)
+    {
+        size_t target = currentWorker() >= 0 ? static_cast<size_t>(currentWorker())
+                                              : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            pending++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->lock);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        wakeUp.notify_one();
+    }
+
+    // runs fn(i) for every i in [0, count) and returns when all of them are done.
+    // the calling thread helps out instead of blocking, so this is safe to call from a worker too.
+    // if fn throws, the chunks not started yet are skipped and the first exception is rethrown here.
+    template<typename Fn>
+    void parallelFor(size_t count, Fn fn)
+    {
+        if (count == 0)
+            return;
+
+        // a few chunks per thread: big enough to amortize the queue traffic,
+        // small enough that stealing can still even out uneven work.
+        size_t chunkCount = (std::min)(count, static_cast<size_t>(size() + 1) * 8);
+        size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        chunkCount = (count + chunkSize - 1) / chunkSize;
+
+        std::atomic<size_t> remaining(chunkCount);
+        std::atomic<bool> failed(false);
+        std::exception_ptr failure;
+        std::mutex failureLock;
+        for (size_t c = 0; c < chunkCount; c++)
+        {
+            size_t begin = c * chunkSize;
+            size_t end = (std::min)(begin + chunkSize, count);
+            submit([&fn, &remaining, &failed, &failure, &failureLock, begin, end]() {
+                // an exception must not escape into a worker (terminate) or skip the count (the caller would wait forever)
+                try
+                {
+                    for (size_t i = begin; i < end && !failed.load(std::memory_order_relaxed); i++)
+                        fn(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(failureLock);
+                    if (!failure)
+                        failure = std::current_exception();
+                    failed.store(true, std::memory_order_relaxed);
+                }
+                remaining.fetch_sub(1, std::memory_order_acq_rel);
+            });
+        }
+
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (!runOne(currentWorker() >= 0 ? static_cast<size_t>(currentWorker()) : 0))
+                std::this_thread::yield();
+        }
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{ 0 };
+
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+    size_t pending = 0;
+    bool stopping = false;
+
+    static int& currentWorker()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    // pops from the back of our own deque first, then walks the others and steals from the front
+    bool takeTask(size_t home, std::function<void()>& task)
+    {
+        {
+            Queue& own = *queues[home];
+            std::lock_guard<std::mutex> lock(own.lock);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            Queue& victim = *queues[(home + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool runOne(size_t home)
+    {
+        std::function<void()> task;
+        if (!takeTask(home, task))
+            return false;
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            pending--;
+        }
+        task();
+        return true;
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        currentWorker() = static_cast<int>(index);
+        for (;;)
+        {
+            if (runOne(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(sleepLock);
+            wakeUp.wait(lock, [this]() { return stopping || pending > 0; });
+            if (stopping && pending == 0)
+                return;
+        }
+    }
+};
+
+#endif // !THREAD_POOL_H
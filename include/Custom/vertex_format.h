@@ -0,0 +1,290 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define MAX_BONE_INFLUENCE 4
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+    //bone indexes which will influence this vertex
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    //weights from each bone
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// Compact GPU vertex layouts.
+// Import keeps working on the full 136 byte Vertex, the upload only gets the attributes a mesh actually uses:
+//   position  3 x float                                  location 0, 12 bytes, always
+//   normal    octahedral, 2 x snorm16                     location 1,  4 bytes, meshes without a tangent frame
+//   uv        2 x unorm16, 2 x half or 2 x float          location 2,  4/4/8 bytes
+//   frame     quaternion tangent frame, 4 x snorm16       location 3,  8 bytes, replaces normal/tangent/bitangent
+//   bones     4 x uint16 ids + 4 x unorm8 weights         location 5/6, 12 bytes, skinned meshes only
+// A textured, normal mapped static mesh goes from 136 to 24 bytes per vertex.
+// model_loading_vs.glsl decodes the normal and the frame, the `tangentFrame` uniform tells it which one is bound.
+
+enum VertexAttributeBits : unsigned int
+{
+    VERTEX_NORMAL        = 1 << 0,
+    VERTEX_UV_UNORM      = 1 << 1,   // every uv inside [0, 1]
+    VERTEX_UV_HALF       = 1 << 2,
+    VERTEX_UV_FLOAT      = 1 << 3,   // tiled far outside [0, 1], half would lose too much precision
+    VERTEX_TANGENT_FRAME = 1 << 4,
+    VERTEX_SKINNED       = 1 << 5,
+};
+
+const unsigned int VERTEX_UV_MASK = VERTEX_UV_UNORM | VERTEX_UV_HALF | VERTEX_UV_FLOAT;
+
+struct VertexFormat
+{
+    unsigned int flags = 0;
+    unsigned int stride = 0;
+    unsigned int normalOffset = 0, uvOffset = 0, frameOffset = 0, boneOffset = 0, weightOffset = 0;
+
+    bool has(unsigned int bits) const { return (flags & bits) != 0; }
+};
+
+inline VertexFormat makeVertexFormat(unsigned int flags)
+{
+    // a tangent frame carries the normal too
+    if (flags & VERTEX_TANGENT_FRAME)
+        flags &= ~VERTEX_NORMAL;
+
+    VertexFormat format;
+    format.flags = flags;
+    unsigned int offset = sizeof(float) * 3;
+    if (flags & VERTEX_NORMAL)
+    {
+        format.normalOffset = offset;
+        offset += 2 * sizeof(int16_t);
+    }
+    if (flags & VERTEX_TANGENT_FRAME)
+    {
+        format.frameOffset = offset;
+        offset += 4 * sizeof(int16_t);
+    }
+    if (flags & (VERTEX_UV_UNORM | VERTEX_UV_HALF))
+    {
+        format.uvOffset = offset;
+        offset += 2 * sizeof(uint16_t);
+    }
+    else if (flags & VERTEX_UV_FLOAT)
+    {
+        format.uvOffset = offset;
+        offset += 2 * sizeof(float);
+    }
+    if (flags & VERTEX_SKINNED)
+    {
+        format.boneOffset = offset;
+        offset += 4 * sizeof(uint16_t);
+        format.weightOffset = offset;
+        offset += 4 * sizeof(uint8_t);
+    }
+    format.stride = offset;
+    return format;
+}
+
+// largest |uv| stored as half floats, anything beyond goes to full floats
+const float VERTEX_UV_HALF_LIMIT = 2.0f;
+
+// picks the cheapest uv encoding that still represents every uv of the mesh well
+inline unsigned int chooseUvEncoding(const Vertex* vertices, size_t count)
+{
+    glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+    for (size_t i = 0; i < count; i++)
+    {
+        low = glm::min(low, vertices[i].TexCoords);
+        high = glm::max(high, vertices[i].TexCoords);
+    }
+    if (low.x >= 0.0f && low.y >= 0.0f && high.x <= 1.0f && high.y <= 1.0f)
+        return VERTEX_UV_UNORM;
+    // half has 10 mantissa bits: up to 2 a uv is off by at most 1/2048, half a texel of a 1024 texture.
+    // From 2 to 4 that doubles and keeps doubling, tiled and CAD unwrapped uvs beyond it visibly distort
+    if (glm::max(glm::max(-low.x, -low.y), glm::max(high.x, high.y)) <= VERTEX_UV_HALF_LIMIT)
+        return VERTEX_UV_HALF;
+    return VERTEX_UV_FLOAT;
+}
+
+// octahedral mapping of a unit vector to [-1, 1]^2
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+    n /= (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        e = (1.0f - glm::abs(glm::vec2(n.y, n.x)));
+        e.x *= n.x >= 0.0f ? 1.0f : -1.0f;
+        e.y *= n.y >= 0.0f ? 1.0f : -1.0f;
+    }
+    return e;
+}
+
+// rotation taking x/z to tangent/normal. The sign of w holds the bitangent handedness,
+// so w is kept away from zero to survive the snorm16 quantization.
+inline glm::quat encodeTangentFrame(glm::vec3 normal, glm::vec3 tangent, const glm::vec3& bitangent)
+{
+    normal = glm::normalize(normal);
+    tangent = tangent - normal * glm::dot(normal, tangent);
+    if (glm::dot(tangent, tangent) < 1e-12f)
+    {
+        // degenerate tangent, any vector perpendicular to the normal will do
+        tangent = std::abs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    tangent = glm::normalize(tangent);
+    glm::vec3 ortho = glm::cross(normal, tangent);
+    const bool reflected = glm::dot(ortho, bitangent) < 0.0f;
+
+    glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(tangent, ortho, normal)));
+    if (q.w < 0.0f)
+        q = -q;
+    const float bias = 1.0f / 8192.0f;
+    if (q.w < bias)
+    {
+        const float scale = std::sqrt(1.0f - bias * bias);
+        q = glm::quat(bias, q.x * scale, q.y * scale, q.z * scale);
+    }
+    if (reflected)
+        q = -q;
+    return q;
+}
+
+// converts full vertices into the packed layout described by format, appending to out
+inline void packVertices(const Vertex* vertices, size_t count, const VertexFormat& format, std::vector<unsigned char>& out)
+{
+    const size_t start = out.size();
+    out.resize(start + count * format.stride);
+    unsigned char* dst = out.data() + start;
+
+    for (size_t i = 0; i < count; i++, dst += format.stride)
+    {
+        const Vertex& vertex = vertices[i];
+        std::memcpy(dst, &vertex.Position, sizeof(float) * 3);
+
+        if (format.has(VERTEX_NORMAL))
+        {
+            glm::vec2 e = glm::dot(vertex.Normal, vertex.Normal) > 0.0f ? octEncode(vertex.Normal) : glm::vec2(0.0f);
+            int16_t packed[2] = { (int16_t)glm::packSnorm1x16(e.x), (int16_t)glm::packSnorm1x16(e.y) };
+            std::memcpy(dst + format.normalOffset, packed, sizeof(packed));
+        }
+        if (format.has(VERTEX_TANGENT_FRAME))
+        {
+            glm::quat q = encodeTangentFrame(vertex.Normal, vertex.Tangent, vertex.Bitangent);
+            int16_t packed[4] = { (int16_t)glm::packSnorm1x16(q.x), (int16_t)glm::packSnorm1x16(q.y),
+                                  (int16_t)glm::packSnorm1x16(q.z), (int16_t)glm::packSnorm1x16(q.w) };
+            std::memcpy(dst + format.frameOffset, packed, sizeof(packed));
+        }
+        if (format.has(VERTEX_UV_UNORM))
+        {
+            uint16_t packed[2] = { glm::packUnorm1x16(vertex.TexCoords.x), glm::packUnorm1x16(vertex.TexCoords.y) };
+            std::memcpy(dst + format.uvOffset, packed, sizeof(packed));
+        }
+        else if (format.has(VERTEX_UV_HALF))
+        {
+            uint16_t packed[2] = { glm::packHalf1x16(vertex.TexCoords.x), glm::packHalf1x16(vertex.TexCoords.y) };
+            std::memcpy(dst + format.uvOffset, packed, sizeof(packed));
+        }
+        else if (format.has(VERTEX_UV_FLOAT))
+        {
+            std::memcpy(dst + format.uvOffset, &vertex.TexCoords, sizeof(float) * 2);
+        }
+        if (format.has(VERTEX_SKINNED))
+        {
+            uint16_t bones[4];
+            uint8_t weights[4];
+            for (int b = 0; b < 4; b++)
+            {
+                bones[b] = static_cast<uint16_t>(vertex.m_BoneIDs[b] < 0 ? 0 : vertex.m_BoneIDs[b]);
+                weights[b] = static_cast<uint8_t>(glm::clamp(vertex.m_Weights[b], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+            std::memcpy(dst + format.boneOffset, bones, sizeof(bones));
+            std::memcpy(dst + format.weightOffset, weights, sizeof(weights));
+        }
+    }
+}
+
+// GL thread, with the VAO and the vertex buffer bound: points the attributes at the packed layout
+inline void setupVertexAttributes(const VertexFormat& format)
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, format.stride, (void*)0);
+    // vertex normals, octahedral
+    if (format.has(VERTEX_NORMAL))
+    {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, format.stride, (void*)(uintptr_t)format.normalOffset);
+    }
+    // vertex texture coords
+    if (format.has(VERTEX_UV_UNORM))
+    {
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, format.stride, (void*)(uintptr_t)format.uvOffset);
+    }
+    else if (format.has(VERTEX_UV_HALF))
+    {
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, format.stride, (void*)(uintptr_t)format.uvOffset);
+    }
+    else if (format.has(VERTEX_UV_FLOAT))
+    {
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, format.stride, (void*)(uintptr_t)format.uvOffset);
+    }
+    // tangent frame quaternion
+    if (format.has(VERTEX_TANGENT_FRAME))
+    {
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, format.stride, (void*)(uintptr_t)format.frameOffset);
+    }
+    if (format.has(VERTEX_SKINNED))
+    {
+        // ids
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_SHORT, format.stride, (void*)(uintptr_t)format.boneOffset);
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, format.stride, (void*)(uintptr_t)format.weightOffset);
+    }
+}
+
+// looks at the data itself, for meshes that don't come with Assimp's flags
+inline unsigned int deduceVertexFlags(const Vertex* vertices, size_t count)
+{
+    bool normals = false, uvs = false, tangents = false, skinned = false;
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vertex& vertex = vertices[i];
+        normals = normals || glm::dot(vertex.Normal, vertex.Normal) > 0.0f;
+        uvs = uvs || vertex.TexCoords != glm::vec2(0.0f);
+        tangents = tangents || glm::dot(vertex.Tangent, vertex.Tangent) > 0.0f;
+        skinned = skinned || vertex.m_Weights[0] > 0.0f;
+    }
+    unsigned int flags = 0;
+    if (normals)
+        flags |= tangents ? VERTEX_TANGENT_FRAME : VERTEX_NORMAL;
+    if (uvs)
+        flags |= chooseUvEncoding(vertices, count);
+    if (skinned)
+        flags |= VERTEX_SKINNED;
+    return flags;
+}
+
+#endif // !VERTEX_FORMAT_H
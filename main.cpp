@@ -1,6 +1,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#define NOMINMAX // windows.h min/max macros break glm::min/glm::max in the model headers
 #include <winsock2.h>
 #include <WS2tcpip.h>
 #include <windows.h>
@@ -15,6 +16,9 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <Custom/shader_s.h>
 #include <Custom/model.h>
+#include <Custom/model_import.h>
+#include <Custom/frame_pacer.h>
+#include <Custom/gesture_input.h>
 
 #include <iostream>
 #include <string>
@@ -28,16 +32,31 @@
 
 #pragma comment(lib, "Ws2_32.lib")
 #define PORT 12345
-#define BUFF_LEN 512
+
+// how the hand tracker delivers its gestures, picked with --gestures=tcp (the default) or --gestures=shm
+enum GestureTransport {
+	GESTURE_TRANSPORT_TCP,     // loopback socket on PORT
+	GESTURE_TRANSPORT_SHM      // GestureSharedMemory ring, for a tracker on this machine
+};
 
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 800;
+// time a running import may spend uploading per frame
+const float IMPORT_UPLOAD_BUDGET_MS = 4.0f;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void char_callback(GLFWwindow* window, unsigned int codepoint);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void window_focus_callback(GLFWwindow* window, int focused);
+void window_refresh_callback(GLFWwindow* window);
+double ProcessCpuSeconds();
+bool ListenForGestures(SOCKET& socketObj);
 void FitToScreen();
+void FitModel(const Model& shown);
 void ProcessOrbitMotion(float xoffset, float yoffset);
 void ProcessPanMotion(float xoffset, float yoffset);
 
@@ -56,6 +75,10 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 Model* ourModel = nullptr;
+ModelImport modelImport;
+bool importFitted = false; // the camera already moved to the import in progress
+bool showWireframe = true; // blue edges over the filled model, drawn by the model shader in the same pass
+FramePacer framePacer;     // skips frames while nothing on screen changes
 
 float modelWidth, modelHeight;
 glm::vec3 modelCenter;
@@ -93,7 +116,15 @@ std::string OpenFileDialog() {
 	return "";
 }
 
-int main() {
+int main(int argc, char** argv) {
+
+	GestureTransport gestureTransport = GESTURE_TRANSPORT_TCP;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--gestures=shm") == 0)
+			gestureTransport = GESTURE_TRANSPORT_SHM;
+		else if (std::strcmp(argv[i], "--gestures=tcp") == 0)
+			gestureTransport = GESTURE_TRANSPORT_TCP;
+	}
 
 	//####################  N E T W O R K S ###########################//
 
@@ -109,71 +140,20 @@ int main() {
 		std::cout << "Winsock initialized successfully!" << '\n';
 	}
 
+	// trackers connect whenever they like once the gesture thread runs, the viewer starts without them.
+	// Without a transport it still runs, only without gestures.
 	SOCKET socketObj = INVALID_SOCKET;
-	socketObj = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if (socketObj == INVALID_SOCKET)
-	{
-		std::cout << "Error Intializing the Socket!" << WSAGetLastError() << '\n';
-		WSACleanup();
-		return -1;
-	}
-	else
-	{
-		std::cout << "Socket is created Successfully!" << '\n';
-	}
-	const char* ip = "127.0.0.1";
-	sockaddr_in address;
-	address.sin_family = AF_INET;
-	//address.sin_addr.s_addr = inet_addr("127.0.0.1");
-	inet_pton(AF_INET, ip, &(address.sin_addr));
-	address.sin_port = htons(PORT);
-
-	if (bind(socketObj, reinterpret_cast<SOCKADDR*>(&address), sizeof(address)) == SOCKET_ERROR)
-	{
-		std::cout << "Failed to bind the socket!" << WSAGetLastError() << '\n';
-		closesocket(socketObj);
-		WSACleanup();
-		return -1;
-	}
-	else
-	{
-		std::cout << "Socket Binded Successfully!" << '\n';
-	}
-
-
-
-	if (listen(socketObj, SOMAXCONN) == SOCKET_ERROR)
-	{
-		std::cout << "Failed to bind the socket!" << WSAGetLastError() << '\n';
-		closesocket(socketObj);
-		WSACleanup();
-		return -1;
-	}
-	else
-	{
-		std::cout << "Listening.........." << '\n';
-	}
-	SOCKET clientSocket = INVALID_SOCKET;
-
-	clientSocket = accept(socketObj, (sockaddr*)nullptr, (int*)nullptr);
-
-	if (clientSocket == INVALID_SOCKET)
-	{
-		std::cout << "Accept Failed! " << WSAGetLastError() << '\n';
-		closesocket(socketObj);
-		WSACleanup();
-		return -1;
+	GestureSharedMemory gestureRing;
+	bool gesturesReady = false;
+	if (gestureTransport == GESTURE_TRANSPORT_SHM) {
+		gesturesReady = gestureRing.open();
+		if (gesturesReady)
+			std::cout << "Waiting for gestures on " << GESTURE_SHM_NAME << '\n';
 	}
-	else
-	{
-		std::cout << "Connection Accepted OK!" << '\n';
+	else {
+		gesturesReady = ListenForGestures(socketObj);
 	}
 
-	u_long mode = 1; // 1 to enable non-blocking mode
-	ioctlsocket(clientSocket, FIONBIO, &mode);
-
-	char receiveBuffer[BUFF_LEN];
-
 	//####################  N E T W O R K S ###########################//
 
 
@@ -184,6 +164,8 @@ int main() {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
+	// cold start is timed from window creation
+	const auto windowCreated = std::chrono::steady_clock::now();
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GripXel MK 1", NULL, NULL);
 
 	if (window == NULL) {
@@ -196,6 +178,12 @@ int main() {
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	// only there to wake the frame pacer, ImGui chains them into its own callbacks
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetCharCallback(window, char_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetWindowFocusCallback(window, window_focus_callback);
+	glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
 	//Load Glad
 
@@ -204,6 +192,7 @@ int main() {
 		glfwTerminate();
 		return -1;
 	}
+	ProgramCache::instance().init((GLADloadproc)glfwGetProcAddress);
 
 	// tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
 	stbi_set_flip_vertically_on_load(true);
@@ -227,45 +216,145 @@ int main() {
 	// Setup ImGui Style
 	ImGui::StyleColorsDark();
 
-	Shader ourShader("model_loading_vs.glsl", "model_loading_fs.glsl");
-	Shader blueShader("model_loading_blue_vs.glsl", "model_loading_blue_fs.glsl");
+	// start every program before waiting on any, the driver compiles them side by side when it can.
+	// The render loop polls them and finishes them once they're done, until then its frames go out without the model.
+	const auto shadersStarted = std::chrono::steady_clock::now();
+	Shader ourShader("model_loading_vs.glsl", "model_loading_fs.glsl", "model_loading_gs.glsl", true);
+	Shader blueShader("model_loading_blue_vs.glsl", "model_loading_blue_fs.glsl", nullptr, true);
+	bool shadersReady = false;
+	float shaderMs = 0.0f;
+	bool firstFrame = true;
+	CameraUniformBuffer cameraUniforms;
+
+	//####################  N E T W O R K S ###########################//
+
+	// gestures are read on a thread of their own, it wakes the render loop when it queued some
+	GestureInput gestureInput;
+	if (gesturesReady && gestureTransport == GESTURE_TRANSPORT_SHM)
+		gestureInput.start(gestureRing, FramePacer::wake);
+	else if (gesturesReady)
+		gestureInput.start(socketObj, FramePacer::wake);
+
+	//####################  N E T W O R K S ###########################//
+
+	// what the last frame showed, a difference makes the next one due
+	const Model* drawnModel = nullptr;
+	glm::mat4 drawnModelMatrix(0.0f), drawnView(0.0f);
+	float drawnZoom = 0.0f;
+	bool drawnWireframe = showWireframe;
 
 	//Render Engine
 	while (!glfwWindowShouldClose(window)) {
 
+		// blocks while nothing changed, time spent asleep isn't frame time
+		lastFrame += static_cast<float>(framePacer.wait());
 		float currentFrame = static_cast<float>(glfwGetTime());
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		processInput(window);
 
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |GL_STENCIL_BUFFER_BIT);
+		// finish any textures that were decoded in the background since the last frame
+		TextureLoader::instance().pump();
 
-		// don't forget to enable shader before setting uniforms
-		ourShader.use();
-		//blueShader.use();
+		// pick the programs up as soon as the driver is done compiling them, finish() won't wait then
+		if (!shadersReady && ourShader.ready() && blueShader.ready()) {
+			ourShader.finish();
+			blueShader.finish();
+			shadersReady = true;
+			shaderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - shadersStarted).count();
+			framePacer.invalidate();
+		}
+
+		// swap in a finished import. The old model stayed on screen until now.
+		if (modelImport.ready()) {
+			Model* imported = modelImport.take();
+			if (imported != nullptr) {
+				if (ourModel != nullptr) {
+					delete ourModel; // Clean up the previous model if any
+				}
+				ourModel = imported;
+				FitModel(*ourModel);
+			}
+			else {
+				std::cout << "Import cancelled or failed." << std::endl;
+				if (importFitted && ourModel != nullptr) {
+					FitModel(*ourModel); // back to the model that stays
+				}
+			}
+			importFitted = false;
+		}
+
+		// a running import is shown as soon as its bounds are known: boxes, then coarse levels, then the full meshes
+		Model* shownModel = ourModel;
+		if (Model* partial = modelImport.partial()) {
+			partial->pump(IMPORT_UPLOAD_BUDGET_MS);
+			if (!importFitted) {
+				FitModel(*partial);
+				importFitted = true;
+			}
+			shownModel = partial;
+		}
+
+		//####################  N E T W O R K S ###########################//
+
+		// everything the gesture thread queued since the last iteration, the newest pan position wins
+		const GestureFrame gestures = gestureInput.drain();
+		if (gestures.pan && ourModel != nullptr) {
+			ProcessPanMotion(gestures.panX / 0.1f, gestures.panY / 0.1f);
+			cout << gestures.panX << " - " << gestures.panY << '\n';
+		}
+		if (gestures.orbit && ourModel != nullptr) {
+			model = glm::rotate(model, glm::radians((float)glfwGetTime()*0.2f), glm::vec3(1.0f, 0.0f, 0.0f));
+		}
+
+		//####################  N E T W O R K S ###########################//
 
-		// view/projection transformations
+		// view/projection transformations, shared by both shaders through the Camera uniform block
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		view = camera.GetViewMatrix();
-		ourShader.setMat4("projection", projection);
-		ourShader.setMat4("view", view);
 
-		ourShader.setMat4("model", model);
+		if (shownModel != drawnModel || model != drawnModelMatrix || view != drawnView || camera.Zoom != drawnZoom || showWireframe != drawnWireframe) {
+			framePacer.invalidate();
+		}
+		// work in progress changes the picture on its own
+		if (!shadersReady || modelImport.busy() || TextureLoader::instance().pending() > 0 || (shownModel != nullptr && shownModel->animating())) {
+			framePacer.animate();
+		}
+		framePacer.report(ProcessCpuSeconds());
+		if (!framePacer.due()) {
+			continue;
+		}
+		drawnModel = shownModel;
+		drawnModelMatrix = model;
+		drawnView = view;
+		drawnZoom = camera.Zoom;
+		drawnWireframe = showWireframe;
+
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |GL_STENCIL_BUFFER_BIT);
 
-		blueShader.use();
+		cameraUniforms.update(projection, view);
 
-		blueShader.setMat4("projection", projection);
-		blueShader.setMat4("view", view);
-		glm::mat4 blueModel = model;
-		//blueModel = glm::scale(model, glm::vec3(0.95f,0.95f,0.95f));
-		blueShader.setMat4("model", blueModel);
+		// don't forget to enable shader before setting uniforms
+		if (shadersReady) {
+			ourShader.use();
+			ourShader.setMat4(UNIFORM_MODEL, model);
+			ourShader.setInt(UNIFORM_WIREFRAME, showWireframe ? 1 : 0);
+
+			blueShader.use();
+			glm::mat4 blueModel = model;
+			//blueModel = glm::scale(model, glm::vec3(0.95f,0.95f,0.95f));
+			blueShader.setMat4(UNIFORM_MODEL, blueModel);
+		}
 
-		// Render the loaded model (if it's loaded)
-		if (ourModel != nullptr) {
+		// Render the loaded model (if it's loaded and the shaders are)
+		if (shownModel != nullptr && shadersReady) {
 			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-			ourModel->Draw(ourShader, blueShader); // Draw the model
+			int framebufferWidth, framebufferHeight;
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			shownModel->selectLods(model, view, projection, (float)framebufferHeight, deltaTime); // level of detail per mesh for this frame
+			shownModel->Draw(ourShader, blueShader); // Draw the model
 			//std::cout << "Model loaded with " << ourModel->meshes.size() << " meshes." << std::endl;
 
 		}
@@ -278,20 +367,12 @@ int main() {
 		// Menu Bar
 		if (ImGui::BeginMainMenuBar()) {
 			if (ImGui::BeginMenu("File")) {
-				if (ImGui::MenuItem("Import")) {
+				if (ImGui::MenuItem("Import", NULL, false, !modelImport.busy())) {
 					std::string selectedFile = OpenFileDialog();
 					if (!selectedFile.empty()) {
 						std::cout << "Selected File: " << selectedFile << std::endl;
 						//selectedFile = "\"" + selectedFile + "\"";
-						if (ourModel != nullptr) {
-							delete ourModel; // Clean up the previous model if any
-						}
-						ourModel = new Model(selectedFile); // Load the new model
-						modelWidth = ourModel->modelWidth;
-						modelHeight = ourModel->modelHeight;
-						modelCenter = ourModel->modelCenter;
-						boundingBoxDiagonal = std::sqrt(modelWidth * modelWidth + modelHeight * modelHeight);
-						FitToScreen();
+						modelImport.start(selectedFile); // Load the new model in the background
 					}
 					else {
 						std::cout << "No file selected." << std::endl;
@@ -303,6 +384,10 @@ int main() {
 				ImGui::MenuItem("Undo", "Ctrl+Z");
 				ImGui::EndMenu();
 			}
+			if (ImGui::BeginMenu("View")) {
+				ImGui::MenuItem("Wireframe", NULL, &showWireframe);
+				ImGui::EndMenu();
+			}
 			if (ImGui::BeginMenu("Help")) {
 				ImGui::MenuItem("About");
 				ImGui::EndMenu();
@@ -310,46 +395,46 @@ int main() {
 			ImGui::EndMainMenuBar();
 
 		}
+
+		// Import progress
+		if (modelImport.busy()) {
+			ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+			ImGui::Begin("Importing", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings);
+			ImGui::Text("%s", modelImport.name().c_str());
+			ImGui::ProgressBar(modelImport.fraction(), ImVec2(300.0f, 0.0f));
+			if (modelImport.cancelling()) {
+				ImGui::TextDisabled("Cancelling...");
+			}
+			else if (ImGui::Button("Cancel")) {
+				modelImport.cancel();
+			}
+			ImGui::End();
+		}
 		// Render ImGui
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 		glfwSwapBuffers(window);
-		glfwPollEvents();
-
-		//####################  N E T W O R K S ###########################//
-
-		memset(receiveBuffer, 0, sizeof(receiveBuffer));
-		int rbyteCount = recv(clientSocket, receiveBuffer, BUFF_LEN, 0);
-		if (rbyteCount > 0) {
-			if (receiveBuffer[0] == 'C' && ourModel != nullptr) {
-				float x_coord, y_coord;
-				std::istringstream stream(receiveBuffer);
-				char c;
-				stream >> c >> x_coord >> y_coord;
-				ProcessPanMotion(x_coord/0.1, y_coord/0.1);
-				cout << x_coord<<" - "<<y_coord << '\n';
-				//model = glm::rotate(model, glm::radians((float)glfwGetTime()*0.2f), glm::vec3(0.0f, 1.0f, 0.0f));
-			}
-			else if (receiveBuffer[0] == 'O' && ourModel != nullptr) {
-				//camera.Zoom += 1.0f;
-				model = glm::rotate(model, glm::radians((float)glfwGetTime()*0.2f), glm::vec3(1.0f, 0.0f, 0.0f));
-			}
-
-			//if (camera.Zoom < 1.0f)
-			//	camera.Zoom = 1.0f;
-			//if (camera.Zoom > 90.0f)
-			//	camera.Zoom = 90.0f;
+		if (firstFrame && shadersReady) {
+			firstFrame = false;
+			std::cout << "STARTUP: first full frame " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - windowCreated).count()
+				<< " ms after window creation, shaders " << shaderMs << " ms (" << ProgramCache::instance().cacheHits() << " of 2 programs from the binary cache)" << std::endl;
 		}
-		else if (rbyteCount == -1 && WSAGetLastError() != WSAEWOULDBLOCK) {
-			std::cerr << "Networking error: " << WSAGetLastError() << std::endl;
-		}
-
+		framePacer.presented();
 	}
 	// Cleanup
+	modelImport.cancel(); // stop a running import before the thread pool and GL context go away
+	delete modelImport.take();
 	if (ourModel != nullptr) {
 		delete ourModel; // Clean up the model
 	}
+	// GL objects die with their owners, release the ones that would otherwise outlive the context
+	ourShader = Shader();
+	blueShader = Shader();
+	cameraUniforms.release();
+	TextureLoader::instance().shutdown();
+	if (glLiveObjects() != 0)
+		std::cout << "ERROR::GL::LEAK " << glLiveObjects() << " GL objects still alive at shutdown" << std::endl;
 
 	// Cleanup ImGui
 	ImGui_ImplOpenGL3_Shutdown();
@@ -360,8 +445,13 @@ int main() {
 
 	//####################  N E T W O R K S ###########################//
 
-	closesocket(clientSocket);
-	closesocket(socketObj);
+	gestureInput.stop();
+	std::cout << "GESTURES: " << gestureInput.appliedCommands() << " applied, mean age " << gestureInput.meanAgeMs() << " ms, "
+		<< gestureInput.stale() << " stale, " << gestureInput.skipped() << " missing from the sequence, "
+		<< gestureInput.dropped() << " dropped by a full queue, " << gestureInput.malformed() << " malformed bytes" << std::endl;
+	gestureRing.close();
+	if (socketObj != INVALID_SOCKET)
+		closesocket(socketObj);
 	WSACleanup();
 
 	//####################  N E T W O R K S ###########################//
@@ -372,6 +462,27 @@ int main() {
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 	glViewport(0, 0, width, height);
+	framePacer.invalidate();
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	framePacer.invalidate();
+}
+
+void char_callback(GLFWwindow* window, unsigned int codepoint) {
+	framePacer.invalidate();
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+	framePacer.invalidate();
+}
+
+void window_focus_callback(GLFWwindow* window, int focused) {
+	framePacer.invalidate();
+}
+
+void window_refresh_callback(GLFWwindow* window) {
+	framePacer.invalidate();
 }
 
 void processInput(GLFWwindow* window) {
@@ -402,6 +513,7 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
 	float xpos = static_cast<float>(xposIn);
 	float ypos = static_cast<float>(yposIn);
+	framePacer.invalidate(); // ImGui hover state follows the cursor
 
 	if (firstMouse) {
 		lastX = xpos;
@@ -428,6 +540,30 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll(static_cast<float>(yoffset));
+	framePacer.invalidate();
+}
+
+// CPU time the whole process used so far, for the frame pacer's idle report
+double ProcessCpuSeconds() {
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+		return 0.0;
+	}
+	ULARGE_INTEGER kernelTime, userTime;
+	kernelTime.LowPart = kernel.dwLowDateTime;
+	kernelTime.HighPart = kernel.dwHighDateTime;
+	userTime.LowPart = user.dwLowDateTime;
+	userTime.HighPart = user.dwHighDateTime;
+	return (kernelTime.QuadPart + userTime.QuadPart) * 1e-7; // 100 ns ticks
+}
+
+// takes over the size of a model for the camera controls and frames it
+void FitModel(const Model& shown) {
+	modelWidth = shown.modelWidth;
+	modelHeight = shown.modelHeight;
+	modelCenter = shown.modelCenter;
+	boundingBoxDiagonal = std::sqrt(modelWidth * modelWidth + modelHeight * modelHeight);
+	FitToScreen();
 }
 
 void FitToScreen() {
@@ -466,3 +602,53 @@ void ProcessPanMotion(float xoffset, float yoffset) {
 
 	camera.sneakUpdate();
 }
+
+// opens a non-blocking listener on PORT for GestureInput to serve. On failure the socket is closed and false returned.
+bool ListenForGestures(SOCKET& socketObj) {
+	socketObj = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (socketObj == INVALID_SOCKET)
+	{
+		std::cout << "Error Intializing the Socket!" << WSAGetLastError() << '\n';
+		return false;
+	}
+	else
+	{
+		std::cout << "Socket is created Successfully!" << '\n';
+	}
+	const char* ip = "127.0.0.1";
+	sockaddr_in address;
+	address.sin_family = AF_INET;
+	//address.sin_addr.s_addr = inet_addr("127.0.0.1");
+	inet_pton(AF_INET, ip, &(address.sin_addr));
+	address.sin_port = htons(PORT);
+
+	if (bind(socketObj, reinterpret_cast<SOCKADDR*>(&address), sizeof(address)) == SOCKET_ERROR)
+	{
+		std::cout << "Failed to bind the socket!" << WSAGetLastError() << '\n';
+		closesocket(socketObj);
+		socketObj = INVALID_SOCKET;
+		return false;
+	}
+	else
+	{
+		std::cout << "Socket Binded Successfully!" << '\n';
+	}
+
+
+
+	if (listen(socketObj, SOMAXCONN) == SOCKET_ERROR)
+	{
+		std::cout << "Failed to bind the socket!" << WSAGetLastError() << '\n';
+		closesocket(socketObj);
+		socketObj = INVALID_SOCKET;
+		return false;
+	}
+	else
+	{
+		std::cout << "Listening.........." << '\n';
+	}
+
+	u_long mode = 1; // 1 to enable non-blocking mode, the gesture thread polls it and accepts what's ready
+	ioctlsocket(socketObj, FIONBIO, &mode);
+	return true;
+}
@@ -1,12 +1,15 @@
 #version 330
 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec2 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+	mat4 projection;
+	mat4 view;
+};
 
 void main(){
 	gl_Position = projection* view*model*vec4(aPos,1.0);
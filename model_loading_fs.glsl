@@ -0,0 +1,34 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+noperspective in vec3 Barycentric;
+
+uniform sampler2D texture_diffuse1;
+// LOD cross-fade: 0 draws everything, f > 0 keeps the fragments whose dither value is below f (level fading in),
+// f < 0 keeps the others (level fading out), so both levels together cover every pixel exactly once.
+// A running fade never sends 0, its first frame comes as a tiny f
+uniform float lodFade;
+// wireframe overlay, drawn over the fill in the same pass from the distance to the triangle's edges
+uniform bool wireframe;
+const vec4 wireColor = vec4(0.0, 0.8, 1.0, 1.0);
+const float wireHalfWidth = 1.0; // pixels on each side of an edge, so 2 pixel lines
+
+void main()
+{
+    if (lodFade != 0.0)
+    {
+        // interleaved gradient noise, stable per pixel
+        float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+        if (lodFade > 0.0 ? dither >= lodFade : dither < -lodFade)
+            discard;
+    }
+    FragColor = texture(texture_diffuse1, TexCoords);
+    if (wireframe)
+    {
+        vec3 pixels = Barycentric / fwidth(Barycentric);
+        float edgeDistance = min(min(pixels.x, pixels.y), pixels.z);
+        FragColor = mix(wireColor, FragColor, smoothstep(wireHalfWidth - 0.5, wireHalfWidth + 0.5, edgeDistance));
+    }
+}
@@ -0,0 +1,28 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in VS_OUT
+{
+    vec2 TexCoords;
+    vec3 Normal;
+} gs_in[];
+
+out vec2 TexCoords;
+out vec3 Normal;
+// 1 at a corner, 0 on the edge across from it. Interpolated in screen space so the fragment shader can
+// measure its distance to the nearest edge in pixels and draw the wireframe in the same pass as the fill.
+noperspective out vec3 Barycentric;
+
+void main()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        gl_Position = gl_in[i].gl_Position;
+        TexCoords = gs_in[i].TexCoords;
+        Normal = gs_in[i].Normal;
+        Barycentric = vec3(i == 0 ? 1.0 : 0.0, i == 1 ? 1.0 : 0.0, i == 2 ? 1.0 : 0.0);
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,44 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal;      // octahedral, snorm16
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTangentFrame; // quaternion, snorm16, sign of w = handedness
+
+out VS_OUT
+{
+    vec2 TexCoords;
+    vec3 Normal;
+} vs_out;
+
+uniform mat4 model;
+// shared by every program, filled once per frame (CameraUniformBuffer)
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+};
+uniform bool tangentFrame;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// z axis of the rotation, the tangent and bitangent would be the x and y axes
+vec3 frameNormal(vec4 q)
+{
+    return vec3(2.0 * (q.x * q.z + q.w * q.y),
+                2.0 * (q.y * q.z - q.w * q.x),
+                1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+}
+
+void main()
+{
+    vs_out.TexCoords = aTexCoords;
+    vec3 localNormal = tangentFrame ? frameNormal(normalize(aTangentFrame)) : octDecode(aNormal);
+    vs_out.Normal = mat3(transpose(inverse(model))) * localNormal;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}